@@ -0,0 +1,75 @@
+/**
+ * Microbenchmark of type lookups in cpm::Context.
+ *
+ * Builds deep pointer/array types and function types with many parameters
+ * of those types, and then looks the same types up again and again,
+ * which is what the semantic checker does all the time.
+ *
+ * usage: bench-types [iterations]
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utils/Context.h"
+
+namespace {
+    constexpr size_t depth = 16;
+    constexpr size_t num_params = 8;
+
+    /**
+     * 'int *[1][2]...*' of given depth, alternating pointers and arrays.
+     */
+    cpm::Type *deep_type(cpm::Context &context, size_t depth) {
+        cpm::Type *type = context.getSimpleType("int", false);
+        for (size_t i = 0; i < depth; i++) {
+            if (i % 2)
+                type = context.getArrayType(type, i);
+            else
+                type = context.getPointerType(type, i % 4 == 0);
+        }
+        return type;
+    }
+
+    /**
+     * Function returning a deep type, with parameters of increasing depth.
+     */
+    cpm::FunctionType *deep_function_type(cpm::Context &context) {
+        std::vector<cpm::Type *> params;
+        for (size_t i = 0; i < num_params; i++)
+            params.push_back(deep_type(context, i * depth / num_params));
+        return context.getFunctionType(deep_type(context, depth), std::move(params), false);
+    }
+
+    template<typename F>
+    void measure(const std::string &name, size_t iterations, F f) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+            f();
+        auto end = std::chrono::steady_clock::now();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        std::cout << name << ": " << ns / iterations << " ns/iteration" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 100000;
+
+    std::istringstream source("");
+    cpm::Context context(source);
+
+    cpm::FunctionType *expected = deep_function_type(context);
+    measure("deep pointer/array type", iterations, [&]() {
+        deep_type(context, depth);
+    });
+    measure("deep function type", iterations, [&]() {
+        if (deep_function_type(context) != expected) {
+            std::cerr << "error: function type isn't unique" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    });
+    return EXIT_SUCCESS;
+}
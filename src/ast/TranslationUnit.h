@@ -1,7 +1,9 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
+#include "ast/base/Arena.h"
 #include "ast/base/node_ptr.h"
 #include "ast/decl/declaration.h"
 
@@ -10,6 +12,8 @@
 namespace ast {
     /**
      * Represents a translation unit.
+     *
+     * It owns the arena in which all of its nodes are allocated.
      */
     class TranslationUnit : public Node {
     public:
@@ -24,6 +28,9 @@ namespace ast {
         // clang issues with vector
         TranslationUnit(TranslationUnit &&) = default;
 
+        // declared before the nodes, so that it's destroyed after them
+        std::unique_ptr<Arena> arena;
+
         std::vector<node_ptr<Declaration>> declars;
     };
 }
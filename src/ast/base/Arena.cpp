@@ -0,0 +1,62 @@
+#include "Arena.h"
+
+#include "utils/Statistic.h"
+
+namespace {
+    thread_local ast::Arena *current_arena = nullptr;
+
+    cpm::Statistic ast_bytes("ast", "bytes", "bytes of ast nodes allocated in arenas");
+    cpm::Statistic ast_slabs("ast", "slabs", "slabs allocated by ast arenas");
+}
+
+namespace ast {
+    Arena::Arena(size_t slab_size) :
+            slab_size(slab_size) {}
+
+    Arena::~Arena() {
+        ast_bytes += bytes_used;
+        ast_slabs += slabs.size();
+    }
+
+    void *Arena::allocate_slow(size_t size, size_t alignment) {
+        // big nodes get a slab of their own, so that the rest of the current slab isn't wasted
+        size_t new_slab_size = size + alignment > slab_size / 2 ? size + alignment : slab_size;
+        // not make_unique, the memory doesn't need to be zeroed
+        slabs.emplace_back(new char[new_slab_size]);
+        bytes_allocated += new_slab_size;
+
+        char *slab = slabs.back().get();
+        size_t offset = (alignment - reinterpret_cast<uintptr_t>(slab) % alignment) % alignment;
+        void *res = slab + offset;
+        if (new_slab_size == slab_size) {
+            cur = slab + offset + size;
+            end = slab + new_slab_size;
+        }
+        bytes_used += size;
+        return res;
+    }
+
+    void Arena::absorb(Arena &other) {
+        // the current slab stays the current one, the rest of other's slab is given up
+        for (auto &slab: other.slabs)
+            slabs.push_back(std::move(slab));
+        bytes_used += other.bytes_used;
+        bytes_allocated += other.bytes_allocated;
+        other.slabs.clear();
+        other.cur = other.end = nullptr;
+        other.bytes_used = other.bytes_allocated = 0;
+    }
+
+    Arena *Arena::current() {
+        return current_arena;
+    }
+
+    Arena::Scope::Scope(Arena &arena) :
+            previous(current_arena) {
+        current_arena = &arena;
+    }
+
+    Arena::Scope::~Scope() {
+        current_arena = previous;
+    }
+}
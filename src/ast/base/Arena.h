@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ast {
+    /**
+     * Bump allocator that owns the memory of all ast nodes of a translation unit.
+     *
+     * Nodes are allocated by make_node from the arena that is active on the current
+     * thread, see Arena::Scope. The memory of the nodes is not freed one by one, the
+     * whole arena is freed at once when the translation unit is destroyed.
+     *
+     * Not thread-safe, each thread must allocate from its own arena.
+     */
+    class Arena {
+    public:
+        static constexpr size_t default_slab_size = 64 * 1024;
+
+        explicit Arena(size_t slab_size = default_slab_size);
+
+        ~Arena();
+
+        Arena(const Arena &) = delete;
+
+        Arena &operator=(const Arena &) = delete;
+
+        /**
+         * Allocate uninitialized memory.
+         */
+        void *allocate(size_t size, size_t alignment) {
+            size_t offset = (alignment - reinterpret_cast<uintptr_t>(cur) % alignment) % alignment;
+            if (cur && offset + size <= static_cast<size_t>(end - cur)) {
+                void *res = cur + offset;
+                cur += offset + size;
+                bytes_used += size;
+                return res;
+            }
+            return allocate_slow(size, alignment);
+        }
+
+        /**
+         * @return number of bytes handed out by allocate
+         */
+        size_t getBytesUsed() const {
+            return bytes_used;
+        }
+
+        /**
+         * @return number of bytes allocated from the system, including the unused rest of slabs
+         */
+        size_t getBytesAllocated() const {
+            return bytes_allocated;
+        }
+
+        size_t getNumSlabs() const {
+            return slabs.size();
+        }
+
+        /**
+         * Take over the memory of another arena, the nodes allocated by it stay valid
+         * as long as this arena. 'other' is left empty and can be reused.
+         */
+        void absorb(Arena &other);
+
+        /**
+         * @return the arena that is active on this thread, nullptr if there's none
+         */
+        static Arena *current();
+
+        /**
+         * Makes an arena active on this thread for the lifetime of the scope,
+         * the previously active arena is restored afterwards.
+         */
+        class Scope {
+        public:
+            explicit Scope(Arena &arena);
+
+            ~Scope();
+
+            Scope(const Scope &) = delete;
+
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            Arena *previous;
+        };
+
+    private:
+        size_t slab_size;
+        std::vector<std::unique_ptr<char[]>> slabs;
+        // free part of the current slab
+        char *cur = nullptr;
+        char *end = nullptr;
+        size_t bytes_used = 0;
+        size_t bytes_allocated = 0;
+
+        void *allocate_slow(size_t size, size_t alignment);
+    };
+}
@@ -2,8 +2,8 @@
 
 ast::SourceInfo::SourceInfo(size_t line_no, size_t col_no)
         :
-        line_no(line_no),
-        col_no(col_no) {}
+        line_no(static_cast<uint32_t>(line_no)),
+        col_no(static_cast<uint32_t>(col_no)) {}
 
 ast::SourceInfo::SourceInfo() :
         line_no(0),
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <type_traits>
 
 namespace ast {
     /**
      * Holds source code information.
+     *
+     * This is in every ast node, so it's kept small and trivially copyable.
      */
     struct SourceInfo {
         /**
@@ -28,15 +32,10 @@ namespace ast {
         // line 0 represents unknown line or nodes added by the compiler
         // that don't reflect the original source code, such as implicitly
         // added function declarations
-        size_t line_no;
-        size_t col_no;
-
-    private:
-        // this member is here so that clang-tidy doesn't complain
-        // when I use std::move on SourceInfo objects
-        // -> for now the compiler is right, that moving is useless,
-        // but in the future when this struct is extended, moving might
-        // be needed/warranted
-        std::string not_trivially_copyable_member;
+        uint32_t line_no;
+        uint32_t col_no;
     };
+
+    static_assert(std::is_trivially_copyable_v<SourceInfo>);
+    static_assert(sizeof(SourceInfo) == 8);
 }
@@ -2,17 +2,43 @@
 
 #include <utility>
 #include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Arena.h"
 
 namespace ast {
+    class TranslationUnit;
+
+    /**
+     * Deleter of node_ptr.
+     *
+     * Nodes live in the arena of their translation unit, so only the destructor
+     * is called, the memory is freed together with the arena. The translation unit
+     * itself owns the arena and is allocated on the heap.
+     */
+    struct NodeDeleter {
+        template<class T>
+        void operator()(T *ptr) const {
+            if constexpr (std::is_same_v<T, TranslationUnit>)
+                delete ptr;
+            else
+                ptr->~T();
+        }
+    };
 
     /**
      * This is used in ast nodes to contain child nodes.
      */
     template<class T>
-    using node_ptr = std::unique_ptr<T>;
+    using node_ptr = std::unique_ptr<T, NodeDeleter>;
 
     /**
      * Create a node pointer of given type, optionally as a variant.
+     *
+     * The node is allocated in the arena that is active on the current thread,
+     * see Arena::Scope.
      * @tparam T type of ast node
      * @tparam Var variant that contains T, or T
      * @tparam Args
@@ -21,8 +47,15 @@ namespace ast {
      */
     template<class T, typename Var = T, typename ... Args>
     node_ptr<Var> make_node(Args ... args) {
-        Var v = T(std::forward<Args>(args)...);
-        return std::make_unique<Var>(std::move(v));
+        if constexpr (std::is_same_v<Var, TranslationUnit>) {
+            return node_ptr<Var>(new Var(T(std::forward<Args>(args)...)));
+        } else {
+            Arena *arena = Arena::current();
+            if (!arena)
+                throw std::runtime_error("ast::make_node: no active arena");
+            void *mem = arena->allocate(sizeof(Var), alignof(Var));
+            return node_ptr<Var>(new(mem) Var(T(std::forward<Args>(args)...)));
+        }
     }
 
     /**
@@ -1,8 +1,7 @@
 #pragma once
 
-#include <string>
-
 #include "ast/base/Node.h"
+#include "utils/Symbol.h"
 
 namespace ast {
     enum ClassKey {
@@ -15,12 +14,12 @@ namespace ast {
      */
     class ClassHead : public Node {
     public:
-        ClassHead(SourceInfo src_info, ClassKey key, std::string name) :
+        ClassHead(SourceInfo src_info, ClassKey key, cpm::Symbol name) :
                 Node(std::move(src_info)),
                 key(key),
-                name(std::move(name)) {}
+                name(name) {}
 
         ClassKey key;
-        std::string name;
+        cpm::Symbol name;
     };
 }
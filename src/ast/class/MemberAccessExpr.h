@@ -1,11 +1,13 @@
 #pragma once
 
-#include <string>
+#include <optional>
+
 
 #include "ast/base/Node.h"
 #include "ast/base/node_ptr.h"
 #include "ast/expr/expr.h"
 #include "ast/expr/IdExpr.h"
+#include "utils/Symbol.h"
 
 namespace ast {
     /**
@@ -17,15 +19,18 @@ namespace ast {
     class MemberAccessExpr : public Node {
     public:
         MemberAccessExpr(SourceInfo src_info, node_ptr <Expr> object, bool ptr_access,
-                         std::string member) :
+                         cpm::Symbol member) :
                 Node(std::move(src_info)),
                 object(std::move(object)),
                 ptr_access(ptr_access),
-                member(std::move(member)) {}
+                member(member) {}
 
         node_ptr<Expr> object;
         // whether it was '->' or '.'
         bool ptr_access;
-        std::string member;
+        cpm::Symbol member;
+        // index of the field among the fields of the class, in the order of declaration,
+        // this is set during semantic analysis (not for method calls)
+        std::optional<unsigned> field_index = std::nullopt;
     };
 }
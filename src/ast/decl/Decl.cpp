@@ -1,7 +1,7 @@
 #include "Decl.h"
 
 
-ast::Decl::Decl(SourceInfo src_info, cpm::Type *type, std::string id) :
+ast::Decl::Decl(SourceInfo src_info, cpm::Type *type, cpm::Symbol id) :
         Node(std::move(src_info)),
         type(type),
         id(id) {}
@@ -1,9 +1,11 @@
 #pragma once
 
-#include <string>
+#include <optional>
 
 #include "ast/base/Node.h"
+#include "ast/expr/ConstValue.h"
 #include "type/Type.h"
+#include "utils/Symbol.h"
 
 namespace ast {
 
@@ -24,13 +26,20 @@ namespace ast {
      */
     class Decl : public Node {
     public:
-        Decl(SourceInfo src_info, cpm::Type *type, std::string id);
+        Decl(SourceInfo src_info, cpm::Type *type, cpm::Symbol id);
 
         // ast::FunctionDecl inherits from this
         virtual ~Decl() = default;
 
         cpm::Type *type;
-        std::string id;
+        cpm::Symbol id;
+        // set by the semantic checker when the address of a local variable or parameter
+        // escapes the expression that uses it, e.g. by '&'; only such variables need
+        // a stack slot, see CodegenOptions::ssa_locals
+        bool address_taken = false;
+        // set by the semantic checker for a const variable whose initializer is known
+        // at compile time, so that the uses of the variable can be folded too
+        std::optional<ConstValue> const_value;
     };
 
 }
\ No newline at end of file
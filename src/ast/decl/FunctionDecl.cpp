@@ -1,7 +1,7 @@
 #include "FunctionDecl.h"
 
 
-ast::FunctionDecl::FunctionDecl(SourceInfo src_info, cpm::FunctionType *func_type, std::string id,
+ast::FunctionDecl::FunctionDecl(SourceInfo src_info, cpm::FunctionType *func_type, cpm::Symbol id,
                                 std::vector<node_ptr<Param>> params) :
-        ast::Decl(std::move(src_info), func_type, std::move(id)),
+        ast::Decl(std::move(src_info), func_type, id),
         params(std::move(params)) {}
@@ -11,6 +11,15 @@ namespace ast {
     // resolve cyclical inclusion
     class Param;
 
+    /**
+     * What a function does to the memory its callers can see, in increasing order.
+     */
+    enum class MemoryEffect {
+        None,
+        Read,
+        ReadWrite
+    };
+
     /**
      * Represents a function declarator.
      *
@@ -20,7 +29,7 @@ namespace ast {
      */
     class FunctionDecl : public Decl {
     public:
-        FunctionDecl(SourceInfo src_info, cpm::FunctionType *func_type, std::string id,
+        FunctionDecl(SourceInfo src_info, cpm::FunctionType *func_type, cpm::Symbol id,
                      std::vector<node_ptr<Param>> params);
 
         // clang issues with vector
@@ -31,5 +40,10 @@ namespace ast {
         // pointer to the first declaration of this function, if this is not the first
         // set during semantic analysis
         std::optional<const ast::FunctionDecl *> orig = std::nullopt;
+        // what the function does to the memory, including the functions it calls; set by
+        // the semantic checker for defined functions, see sc::EffectsAnalysis
+        MemoryEffect memory = MemoryEffect::ReadWrite;
+        // whether the function never calls itself, neither directly nor through other functions
+        bool norecurse = false;
     };
 }
\ No newline at end of file
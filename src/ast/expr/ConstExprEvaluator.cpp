@@ -0,0 +1,370 @@
+#include "ConstExprEvaluator.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace ast;
+using Builtin = cpm::SimpleType::Builtin;
+
+namespace {
+    bool is_integral(Builtin b) {
+        return b == Builtin::Int || b == Builtin::Char || b == Builtin::Bool;
+    }
+
+    /**
+     * Truncate an integer to the width of the type, like llvm does for i32, i8 and i1.
+     */
+    int64_t wrap(int64_t val, Builtin type) {
+        auto bits = static_cast<uint64_t>(val);
+        switch (type) {
+            case Builtin::Int:
+                return static_cast<int32_t>(static_cast<uint32_t>(bits));
+            case Builtin::Char:
+                return static_cast<int8_t>(static_cast<uint8_t>(bits));
+            case Builtin::Bool:
+                return static_cast<int64_t>(bits & 1);
+            default:
+                return val;
+        }
+    }
+
+    int bit_width(Builtin type) {
+        return type == Builtin::Int ? 32 : type == Builtin::Char ? 8 : 1;
+    }
+
+    ast::ConstValue integral(int64_t val, Builtin type) {
+        return {type, wrap(val, type)};
+    }
+
+    ast::ConstValue boolean(bool val) {
+        return {Builtin::Bool, val};
+    }
+
+    ast::ConstValue floating(double val) {
+        return {Builtin::Double, 0, val};
+    }
+
+    /**
+     * The common type of two arithmetic types, as SemanticChecker::common_type picks it.
+     */
+    std::optional<Builtin> common_type(Builtin t1, Builtin t2) {
+        if (t1 == t2)
+            return t1;
+        // double only goes together with int
+        if (t1 == Builtin::Double || t2 == Builtin::Double) {
+            if (t1 == Builtin::Int || t2 == Builtin::Int)
+                return Builtin::Double;
+            return std::nullopt;
+        }
+        if (t1 == Builtin::Int || t2 == Builtin::Int)
+            return Builtin::Int;
+        return Builtin::Char;
+    }
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::IntLiteral &node) {
+    return integral(static_cast<int64_t>(node.val), Builtin::Int);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::CharLiteral &node) {
+    return integral(node.c, Builtin::Char);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::BoolLiteral &node) {
+    return boolean(node.val);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::FloatLiteral &node) {
+    return floating(node.val);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::SizeofTypeExpr &node) {
+    std::optional<uint64_t> size = size_of(node.type);
+    if (!size || *size > std::numeric_limits<int32_t>::max())
+        return std::nullopt;
+    // the result of sizeof is int, see SemanticChecker::getSizeofType
+    return integral(static_cast<int64_t>(*size), Builtin::Int);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::BinaryExpr &node) {
+    Result lhs = operand(*node.lhs);
+    if (!lhs)
+        return std::nullopt;
+    // the rhs of '&&' and '||' is not evaluated when the lhs decides
+    if (node.op == ast::LogicalAnd || node.op == ast::LogicalOr) {
+        Result lhs_bool = convert(*lhs, Builtin::Bool);
+        if (!lhs_bool)
+            return std::nullopt;
+        if (lhs_bool->int_val == (node.op == ast::LogicalOr))
+            return lhs_bool;
+        Result rhs = operand(*node.rhs);
+        return rhs ? convert(*rhs, Builtin::Bool) : std::nullopt;
+    }
+
+    Result rhs = operand(*node.rhs);
+    if (!rhs)
+        return std::nullopt;
+    std::optional<Builtin> op_type = operand_type(node.op, lhs->type, rhs->type);
+    if (!op_type)
+        return std::nullopt;
+    lhs = convert(*lhs, *op_type);
+    rhs = convert(*rhs, *op_type);
+    if (!lhs || !rhs)
+        return std::nullopt;
+    if (*op_type == Builtin::Double)
+        return double_op(node.op, *lhs, *rhs);
+    return integral_op(node.op, *lhs, *rhs);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::UnaryExpr &node) {
+    Result val = operand(*node.expr);
+    if (!val)
+        return std::nullopt;
+    Builtin type = val->type;
+    switch (node.op) {
+        case ast::UnPlus:
+            return val;
+        case ast::UnMinus:
+            if (type == Builtin::Double)
+                // the same as 'fsub 0, x', not 'fneg x'
+                return floating(0.0 - val->double_val);
+            if (type == Builtin::Bool)
+                break;
+            return integral(-val->int_val, type);
+        case ast::BitNot:
+            if (type == Builtin::Double)
+                break;
+            return integral(~val->int_val, type);
+        case ast::Not:
+            if ((val = convert(*val, Builtin::Bool)))
+                return boolean(!val->int_val);
+            break;
+        default:
+            break;
+    }
+    return std::nullopt;
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::TernaryExpr &node) {
+    Result cond = operand(*node.cond);
+    if (!cond || !(cond = convert(*cond, Builtin::Bool)))
+        return std::nullopt;
+    // only the chosen branch is evaluated at runtime too
+    const ast::Expr &chosen = cond->int_val ? *node.then : *node.else_;
+    Result val = operand(chosen);
+    if (checked || !val)
+        return val;
+    // without the semantic checker, the branches aren't converted to their common type
+    Result other = operand(cond->int_val ? *node.else_ : *node.then);
+    if (!other)
+        return std::nullopt;
+    std::optional<Builtin> type = common_type(val->type, other->type);
+    return type ? convert(*val, *type) : std::nullopt;
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::CommaExpr &node) {
+    Result res;
+    for (const auto &e: node.expressions)
+        if (!(res = operand(*e)))
+            return std::nullopt;
+    return res;
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::CastExpr &node) {
+    std::optional<Builtin> dest = arithmetic_type(node.type);
+    Result val = operand(*node.expr);
+    if (!dest || !val)
+        return std::nullopt;
+    return convert(*val, *dest);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::ImplicitTypeCastExpr &node) {
+    std::optional<Builtin> dest = arithmetic_type(node.dest_ty);
+    Result val = operand(*node.val);
+    if (!dest || !val)
+        return std::nullopt;
+    return convert(*val, *dest);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::LValToRValExpr &node) {
+    // reading a const variable with a known value
+    if (const auto *id_expr = get_if<ast::IdExpr>(node.val.get()))
+        if (id_expr->var.has_value())
+            return id_expr->var.value()->const_value;
+    return std::nullopt;
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::DefaultArgExpr &node) {
+    return operand(*node.expr);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operator()(const ast::ConstantExpr &node) {
+    return node.value;
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::operand(const ast::Expr &node) {
+    if (checked && !holds_alternative<ast::ConstantExpr>(node) &&
+        !holds_alternative<ast::IntLiteral>(node) &&
+        !holds_alternative<ast::CharLiteral>(node) &&
+        !holds_alternative<ast::BoolLiteral>(node) &&
+        !holds_alternative<ast::FloatLiteral>(node))
+        return std::nullopt;
+    return (*this)(node);
+}
+
+ConstExprEvaluator::Result ConstExprEvaluator::convert(ast::ConstValue val, Builtin dest) {
+    if (val.type == dest)
+        return val;
+    if (dest == Builtin::Bool) {
+        // 'x != 0', which is false for NaN, see LLBuilder::convert
+        if (val.type == Builtin::Double)
+            return boolean(val.double_val < 0 || val.double_val > 0);
+        return boolean(val.int_val != 0);
+    }
+    if (dest == Builtin::Double)
+        return floating(static_cast<double>(val.int_val));
+    // double to integer, out of range is poison in llvm
+    if (val.type == Builtin::Double) {
+        double truncated = std::trunc(val.double_val);
+        double limit = std::ldexp(1.0, bit_width(dest) - 1);
+        if (!(truncated >= -limit && truncated < limit))
+            return std::nullopt;
+        return integral(static_cast<int64_t>(truncated), dest);
+    }
+    // bool is 0 or 1, so this is both sign-extension and zero-extension
+    return integral(val.int_val, dest);
+}
+
+std::optional<Builtin> ConstExprEvaluator::arithmetic_type(cpm::Type *type) {
+    cpm::SimpleType *st = cpm::simple_ty(type);
+    if (!st)
+        return std::nullopt;
+    Builtin b = st->getBuiltin();
+    if (is_integral(b) || b == Builtin::Double)
+        return b;
+    return std::nullopt;
+}
+
+std::optional<uint64_t> ConstExprEvaluator::size_of(cpm::Type *type) {
+    if (cpm::SimpleType *st = cpm::simple_ty(type)) {
+        switch (st->getBuiltin()) {
+            case Builtin::Int:
+                return 4;
+            case Builtin::Char:
+            case Builtin::Bool:
+                return 1;
+            case Builtin::Double:
+                return 8;
+            case Builtin::Nullptr:
+                return sizeof(void *);
+            default:
+                return std::nullopt;
+        }
+    } else if (cpm::pointer_ty(type))
+        return sizeof(void *);
+    else if (cpm::ArrayType *at = cpm::array_ty(type)) {
+        std::optional<uint64_t> elem_size = size_of(at->getElemType());
+        if (!elem_size || !at->getSize())
+            return std::nullopt;
+        return *elem_size * at->getSize().value();
+    }
+    return std::nullopt;
+}
+
+std::optional<Builtin>
+ConstExprEvaluator::operand_type(ast::BinaryOp op, Builtin lhs, Builtin rhs) {
+    // the same conversions as SemanticChecker::compute_bin_op_conversions
+    if (ast::is_logical_op(op))
+        return Builtin::Bool;
+    if (ast::is_bit_op(op) || op == ast::Mod) {
+        if (is_integral(lhs) && is_integral(rhs))
+            return Builtin::Int;
+        return std::nullopt;
+    }
+    return common_type(lhs, rhs);
+}
+
+ConstExprEvaluator::Result
+ConstExprEvaluator::integral_op(ast::BinaryOp op, ast::ConstValue lhs, ast::ConstValue rhs) {
+    Builtin type = lhs.type;
+    int64_t l = lhs.int_val, r = rhs.int_val;
+    // comparisons of i1 are signed in llvm, so 'true' is less than 'false';
+    // the arithmetic on bool isn't worth getting right either
+    if (type == Builtin::Bool && op != ast::Equal && op != ast::NotEqual &&
+        op != ast::And && op != ast::Or && op != ast::Caret)
+        return std::nullopt;
+    switch (op) {
+        case ast::Plus:
+            return integral(l + r, type);
+        case ast::Minus:
+            return integral(l - r, type);
+        case ast::Star:
+            return integral(l * r, type);
+        case ast::Div:
+        case ast::Mod: {
+            // division by zero and INT_MIN / -1 are undefined
+            int64_t min = -(int64_t(1) << (bit_width(type) - 1));
+            if (r == 0 || (l == min && r == -1))
+                return std::nullopt;
+            return integral(op == ast::Div ? l / r : l % r, type);
+        }
+        case ast::And:
+            return integral(l & r, type);
+        case ast::Or:
+            return integral(l | r, type);
+        case ast::Caret:
+            return integral(l ^ r, type);
+        case ast::LeftShift:
+        case ast::RightShift:
+            // shifting by the width or more is poison
+            if (r < 0 || r >= bit_width(type))
+                return std::nullopt;
+            return integral(op == ast::LeftShift ?
+                            static_cast<int64_t>(static_cast<uint64_t>(l) << r) :
+                            l >> r, type);
+        case ast::Greater:
+            return boolean(l > r);
+        case ast::Less:
+            return boolean(l < r);
+        case ast::GreaterEqual:
+            return boolean(l >= r);
+        case ast::LessEqual:
+            return boolean(l <= r);
+        case ast::Equal:
+            return boolean(l == r);
+        case ast::NotEqual:
+            return boolean(l != r);
+        default:
+            return std::nullopt;
+    }
+}
+
+ConstExprEvaluator::Result
+ConstExprEvaluator::double_op(ast::BinaryOp op, ast::ConstValue lhs, ast::ConstValue rhs) {
+    double l = lhs.double_val, r = rhs.double_val;
+    // the comparisons are ordered, they're false if one of the operands is NaN
+    switch (op) {
+        case ast::Plus:
+            return floating(l + r);
+        case ast::Minus:
+            return floating(l - r);
+        case ast::Star:
+            return floating(l * r);
+        case ast::Div:
+            return floating(l / r);
+        case ast::Greater:
+            return boolean(l > r);
+        case ast::Less:
+            return boolean(l < r);
+        case ast::GreaterEqual:
+            return boolean(l >= r);
+        case ast::LessEqual:
+            return boolean(l <= r);
+        case ast::Equal:
+            return boolean(l == r);
+        case ast::NotEqual:
+            return boolean(l < r || l > r);
+        default:
+            return std::nullopt;
+    }
+}
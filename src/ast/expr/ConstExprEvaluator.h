@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "ast/all_headers.h"
+#include "type/Type.h"
+#include "type/DerivedTypes.h"
+
+namespace ast {
+    /**
+     * Computes the value of an expression at compile time.
+     *
+     * Only rvalues of type int, char, bool and double are evaluated. The arithmetic is
+     * the one LLBuilder generates for the expression: int and char wrap around on overflow,
+     * comparisons of doubles are ordered and so on. Expressions that are undefined
+     * (division by zero, too large shifts, double to int conversion out of range) are not
+     * constant, they're left for the runtime.
+     *
+     * The semantic checker wraps the expressions it can evaluate in ast::ConstantExpr.
+     * The parser evaluates array sizes, before any semantic analysis.
+     */
+    class ConstExprEvaluator {
+    public:
+        using Result = std::optional<ast::ConstValue>;
+
+        /**
+         * @param checked  whether the expressions went through the semantic checker: their
+         *                 conversions are explicit, and their constant operands are already
+         *                 wrapped in ast::ConstantExpr, so any other operand is not constant
+         *                 and the evaluation doesn't have to look into it
+         */
+        explicit ConstExprEvaluator(bool checked) :
+                checked(checked) {}
+
+        /**
+         * @return the value of the expression, nullopt if it's not known at compile time
+         */
+        Result operator()(const ast::Expr &node) {
+            return std::visit(*this, node);
+        }
+
+        Result operator()(const ast::IntLiteral &node);
+
+        Result operator()(const ast::CharLiteral &node);
+
+        Result operator()(const ast::BoolLiteral &node);
+
+        Result operator()(const ast::FloatLiteral &node);
+
+        Result operator()(const ast::SizeofTypeExpr &node);
+
+        Result operator()(const ast::BinaryExpr &node);
+
+        Result operator()(const ast::UnaryExpr &node);
+
+        Result operator()(const ast::TernaryExpr &node);
+
+        Result operator()(const ast::CommaExpr &node);
+
+        Result operator()(const ast::CastExpr &node);
+
+        Result operator()(const ast::ImplicitTypeCastExpr &node);
+
+        Result operator()(const ast::LValToRValExpr &node);
+
+        Result operator()(const ast::DefaultArgExpr &node);
+
+        Result operator()(const ast::ConstantExpr &node);
+
+        // the rest is never constant (calls, assignments, lvalues...)
+        template<typename T>
+        Result operator()(const T &) {
+            return std::nullopt;
+        }
+
+        /**
+         * Convert a value to another type, the same way an implicit or explicit
+         * conversion does.
+         * @param dest  int, char, bool or double
+         */
+        static Result convert(ast::ConstValue val, cpm::SimpleType::Builtin dest);
+
+        /**
+         * @return the builtin of int, char, bool and double, nullopt for other types
+         */
+        static std::optional<cpm::SimpleType::Builtin> arithmetic_type(cpm::Type *type);
+
+        /**
+         * The size of a type in bytes, as llvm lays it out for the host (which is the
+         * target, see Emitter).
+         * @return nullopt for classes, their layout is up to LLBuilder
+         */
+        static std::optional<uint64_t> size_of(cpm::Type *type);
+
+    private:
+        bool checked;
+
+        /**
+         * Evaluate an operand of the expression being evaluated, see 'checked'.
+         */
+        Result operand(const ast::Expr &node);
+
+        /**
+         * The type both operands of a binary operator are converted to.
+         */
+        static std::optional<cpm::SimpleType::Builtin>
+        operand_type(ast::BinaryOp op, cpm::SimpleType::Builtin lhs, cpm::SimpleType::Builtin rhs);
+
+        static Result integral_op(ast::BinaryOp op, ast::ConstValue lhs, ast::ConstValue rhs);
+
+        static Result double_op(ast::BinaryOp op, ast::ConstValue lhs, ast::ConstValue rhs);
+    };
+}
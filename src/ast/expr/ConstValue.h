@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+#include "type/DerivedTypes.h"
+
+namespace ast {
+
+    /**
+     * A value of type int, char, bool or double that's known at compile time.
+     */
+    struct ConstValue {
+        cpm::SimpleType::Builtin type;
+        // the value of the integral types, char is sign-extended, bool is 0 or 1
+        int64_t int_val = 0;
+        double double_val = 0;
+    };
+}
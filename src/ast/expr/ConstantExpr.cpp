@@ -0,0 +1,8 @@
+#include "ConstantExpr.h"
+
+ast::ConstantExpr::ConstantExpr(ast::SourceInfo src_info,
+                                ast::node_ptr<ast::Expr> expr,
+                                ast::ConstValue value) :
+        Node(std::move(src_info)),
+        expr(std::move(expr)),
+        value(value) {}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ast/base/Node.h"
+#include "ast/base/node_ptr.h"
+#include "ast/expr/expr.h"
+#include "ast/expr/ConstValue.h"
+
+namespace ast {
+
+    /**
+     * Represents an expression whose value was computed during semantic analysis,
+     * see ConstExprEvaluator.
+     *
+     * The original expression is kept, but codegen uses only the value. The ast dump
+     * shows just the original expression.
+     *
+     * Example:
+     * 'int a = 3 * 4 + 1'
+     * the initializer is a ConstantExpr with value 13 around the BinaryExpr.
+     */
+    class ConstantExpr : public Node {
+    public:
+        ConstantExpr(SourceInfo src_info, node_ptr<Expr> expr, ConstValue value);
+
+        node_ptr<Expr> expr;
+        ConstValue value;
+    };
+}
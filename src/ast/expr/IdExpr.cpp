@@ -1,5 +1,5 @@
 #include "IdExpr.h"
 
-ast::IdExpr::IdExpr(ast::SourceInfo src_info, std::string id) :
+ast::IdExpr::IdExpr(ast::SourceInfo src_info, cpm::Symbol id) :
         Node(std::move(src_info)),
-        id(std::move(id)) {}
+        id(id) {}
@@ -1,10 +1,10 @@
 #pragma once
 
-#include <string>
 #include <optional>
 
 #include "ast/base/Node.h"
 #include "ast/decl/Decl.h"
+#include "utils/Symbol.h"
 
 namespace ast {
     /**
@@ -20,9 +20,9 @@ namespace ast {
      */
     class IdExpr : public Node {
     public:
-        explicit IdExpr(SourceInfo src_info, std::string id);
+        explicit IdExpr(SourceInfo src_info, cpm::Symbol id);
 
-        std::string id;
+        cpm::Symbol id;
         // this determines to which value this id expression corresponds,
         // this is set during semantic analysis
         std::optional<const ast::Decl *> var = std::nullopt;
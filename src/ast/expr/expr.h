@@ -44,6 +44,8 @@ namespace ast {
 
     class ArrToPtrExpr;
 
+    class ConstantExpr;
+
     /**
      * Represents an expression.
      */
@@ -72,7 +74,8 @@ namespace ast {
             DefaultArgExpr,
             ImplicitTypeCastExpr,
             LValToRValExpr,
-            ArrToPtrExpr
+            ArrToPtrExpr,
+            ConstantExpr
     >;
 }
 
@@ -91,5 +94,6 @@ namespace ast {
 #include "ImplicitTypeCastExpr.h"
 #include "LValToRValExpr.h"
 #include "ArrToPtrExpr.h"
+#include "ConstantExpr.h"
 
 
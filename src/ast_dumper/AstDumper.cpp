@@ -141,7 +141,7 @@ void AstDumper::operator()(const ast::UnaryExpr &node) {
 }
 
 void AstDumper::operator()(const ast::MemberAccessExpr &node) {
-    string info = (node.ptr_access ? "->" : ".") + node.member;
+    string info = (node.ptr_access ? "->" : ".") + node.member.str();
     dump_shared(node, "MemberAccessExpr", info);
     dump_child(*node.object, true);
 }
@@ -285,7 +285,7 @@ void AstDumper::dump_vector(const vector<ast::node_ptr<T>> &v) {
 
 void AstDumper::operator()(const ast::ClassDef &node) {
     dump_shared(node, "ClassDef",
-                (node.head->key == ast::Struct ? "struct " : "class ") + quote(node.head->name));
+                (node.head->key == ast::Struct ? "struct " : "class ") + quote(node.head->name.str()));
     if (node.body)
         dump_child(*node.body.value(), true);
 }
@@ -321,6 +321,11 @@ void AstDumper::operator()(const ast::ArrToPtrExpr &node) {
     dump_child(*node.arr_expr, true);
 }
 
+void AstDumper::operator()(const ast::ConstantExpr &node) {
+    // the value is an annotation for codegen, the dump shows the original expression
+    dump(*node.expr);
+}
+
 std::string AstDumper::quote(const string &s) {
     return "'" + s + "'";
 }
@@ -352,11 +357,11 @@ void AstDumper::operator()(const ast::Decl &node) {
     if (func_decl)
         dump(*func_decl);
     else
-        dump_shared(node, "Decl"s, node.id + " " + cpm::to_string(node.type));
+        dump_shared(node, "Decl"s, node.id.str() + " " + cpm::to_string(node.type));
 }
 
 void AstDumper::operator()(const ast::FunctionDecl &node) {
-    string info = node.id + " " + cpm::to_string(node.type);
+    string info = node.id.str() + " " + cpm::to_string(node.type);
     if (node.orig.has_value())
         info += ", first declaration: line " + to_string(node.orig.value()->src_info.line_no);
     dump_shared(node, "FunctionDecl"s, info);
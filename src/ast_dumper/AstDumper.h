@@ -76,6 +76,8 @@ public:
 
     void operator()(const ast::ArrToPtrExpr &node);
 
+    void operator()(const ast::ConstantExpr &node);
+
     void operator()(const ast::SizeofTypeExpr &node);
 
     void operator()(const ast::Condition &node);
@@ -0,0 +1,250 @@
+#include "Driver.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+#include "parser/Parser.h"
+#include "semantic_checker/SemanticChecker.h"
+#include "ll_builder/LLBuilder.h"
+#include "jit/Jit.h"
+#include "ast_dumper/AstDumper.h"
+
+using namespace std;
+
+namespace cpm::driver {
+    namespace {
+        std::ostream &file_or_cout(optional<ofstream> &output_file, std::ostream &out) {
+            if (!output_file) {
+                return out;
+            }
+
+            return *output_file;
+        }
+    }
+
+    std::string output_extension(cpm::EmitKind kind) {
+        switch (kind) {
+            case cpm::EmitKind::LLVMIR:
+                return ".ll";
+            case cpm::EmitKind::Bitcode:
+                return ".bc";
+            case cpm::EmitKind::Assembly:
+                return ".s";
+            case cpm::EmitKind::Object:
+                return ".o";
+        }
+        return "";
+    }
+
+    int compile(istream &input, const optional<string> &output_path,
+                const CompileOptions &opts, CompileStreams streams) {
+        cpm::Context context(input);
+        return compile(context, output_path, opts, streams);
+    }
+
+    int compile(cpm::Context &context, const optional<string> &output_path,
+                const CompileOptions &opts, CompileStreams streams) {
+        optional<ofstream> output_file;
+
+        optional<cpm::Optimizer> optimizer;
+        // textual ir is printed by LLBuilder, the emitter is needed for the other formats;
+        // the optimizer and the jit need it too, for the host target (triple, data layout
+        // and the cost model), like 'opt' run on the printed module
+        optional<cpm::Emitter> emitter;
+        try {
+            if (opts.emit_kind != cpm::EmitKind::LLVMIR || opts.opt_level != cpm::OptLevel::O0 ||
+                opts.run)
+                emitter.emplace(opts.emit_kind, opts.opt_level);
+            optimizer.emplace(opts.opt_level, emitter ? emitter->getTargetMachine() : nullptr);
+        }
+        catch (const std::exception &e) {
+            streams.err << "error: " << e.what() << endl;
+            return exitCode(ReturnValue::Failure);
+        }
+
+        Parser parser(context, streams.log, streams.err);
+        cpm::sc::SemanticChecker semantic_checker(context, streams.log, opts.max_errors,
+                                                  opts.sema_threads);
+        AstDumper ast_dumper;
+        cpm::CodegenOptions codegen_opts;
+        codegen_opts.discard_value_names = opts.discard_value_names;
+        codegen_opts.threads = opts.codegen_threads;
+        codegen_opts.lifetime_markers = opts.opt_level != cpm::OptLevel::O0;
+        codegen_opts.ssa_locals = opts.ssa_locals;
+        codegen_opts.whole_program = opts.whole_program || opts.run;
+        cpm::LLBuilder ll_builder(codegen_opts);
+        ast::node_ptr<ast::TranslationUnit> ast;
+
+        try {
+            ast = parser.parse();
+        }
+        catch (const Parser::SyntaxError &e) {
+            streams.err << "error: " << e.what() << std::endl;
+            return exitCode(ReturnValue::AntlrSyntaxError);
+        }
+        catch (const Parser::VisitError &e) {
+            streams.err << "error: " << e.what() << std::endl;
+            return exitCode(ReturnValue::AntlrVisitError);
+        }
+        if (opts.stats)
+            streams.err << "parsed with "
+                        << (parser.getParseStage() == Parser::ParseStage::SLL ? "SLL" : "LL")
+                        << " prediction" << endl;
+
+        if (output_path) {
+            output_file = ofstream(*output_path, ios::binary);
+            if (!*output_file) {
+                streams.err << "couldn't open file: " << *output_path << endl;
+                return exitCode(ReturnValue::FileOpen);
+            }
+        }
+
+        //--------- dump raw ast is the user chooses ------------
+        if (opts.ast_dump_raw) {
+            ast_dumper.run(*ast, file_or_cout(output_file, streams.out));
+            return exitCode(ReturnValue::Success);
+        }
+
+        //--------------- perform semantic analysis ----------------
+        try {
+            semantic_checker.run(*ast);
+        }
+        catch (const std::exception &e) {
+            streams.err << e.what() << endl;
+            return exitCode(ReturnValue::ScVisitError);
+        }
+        if (opts.stats)
+            streams.err << "ast: " << ast->arena->getBytesUsed() << " bytes in "
+                        << ast->arena->getNumSlabs() << " slabs" << endl;
+
+        //------------- dump ast if the user chooses -------------
+        if (opts.ast_dump) {
+            ast_dumper.run(*ast, file_or_cout(output_file, streams.out));
+            return exitCode(ReturnValue::Success);
+        }
+
+        //------------- generate llvm ir ----------------------
+        ll_builder.run(ast.get());
+        if (ll_builder.verifyModule()) {
+            // dump the unoptimized module anyway, it helps with debugging
+            ll_builder.dumpModule(file_or_cout(output_file, streams.out));
+            streams.log << "LLVM module verification failed" << endl;
+            return exitCode(ReturnValue::Failure);
+        }
+
+        if (emitter)
+            emitter->prepareModule(ll_builder.getModule());
+
+        //------------- optimize llvm ir ----------------------
+        if (optimizer->getLevel() != cpm::OptLevel::O0) {
+            auto start = chrono::steady_clock::now();
+            optimizer->run(ll_builder.getModule());
+            chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+            if (opts.time)
+                streams.err << "optimization " << cpm::Optimizer::to_string(optimizer->getLevel())
+                            << " took " << elapsed.count() << " ms" << endl;
+        }
+
+        //------------- run the program if the user chooses -------------
+        if (opts.run) {
+            auto [llvm_context, module] = ll_builder.releaseModule();
+            try {
+                return cpm::Jit().run(std::move(llvm_context), std::move(module));
+            }
+            catch (const std::exception &e) {
+                streams.err << "error: " << e.what() << endl;
+                return exitCode(ReturnValue::Failure);
+            }
+        }
+
+        //------------- emit the output ----------------------
+        if (opts.emit_kind == cpm::EmitKind::LLVMIR) {
+            ll_builder.dumpModule(file_or_cout(output_file, streams.out));
+            return exitCode(ReturnValue::Success);
+        }
+
+        try {
+            emitter->run(ll_builder.getModule(), file_or_cout(output_file, streams.out));
+        }
+        catch (const std::exception &e) {
+            streams.err << "error: " << e.what() << endl;
+            return exitCode(ReturnValue::Failure);
+        }
+        return exitCode(ReturnValue::Success);
+    }
+
+    int compile_file(const string &input_path, const optional<string> &output_path,
+                     const CompileOptions &opts, CompileStreams streams) {
+        // the file is mapped into memory instead of being read into a string
+        optional<cpm::Context> context;
+        try {
+            context.emplace(filesystem::path(input_path));
+        }
+        catch (const std::system_error &) {
+            streams.log << "couldn't open file: " << input_path << endl;
+            return exitCode(ReturnValue::FileOpen);
+        }
+        return compile(*context, output_path, opts, streams);
+    }
+
+    int compile_batch(const vector<string> &input_paths, const CompileOptions &opts, unsigned jobs) {
+        struct FileResult {
+            int exit_code = exitCode(ReturnValue::Success);
+            ostringstream out;
+            ostringstream log;
+            ostringstream err;
+        };
+        vector<FileResult> results(input_paths.size());
+
+        // the ast dumps are printed to stdout, everything else goes to files next to the inputs
+        vector<optional<string>> output_paths(input_paths.size());
+        if (!opts.ast_dump && !opts.ast_dump_raw) {
+            // two threads writing the same file would make the result depend on scheduling
+            set<filesystem::path> seen;
+            for (size_t i = 0; i < input_paths.size(); i++) {
+                filesystem::path output = filesystem::path(input_paths[i])
+                        .replace_extension(output_extension(opts.emit_kind)).lexically_normal();
+                if (!seen.insert(output).second) {
+                    cerr << "error: multiple input files would be compiled into "
+                         << output.string() << endl;
+                    return exitCode(ReturnValue::Failure);
+                }
+                output_paths[i] = output.string();
+            }
+        }
+
+        atomic<size_t> next_file = 0;
+        auto worker = [&]() {
+            for (size_t i = next_file++; i < input_paths.size(); i = next_file++) {
+                FileResult &res = results[i];
+                res.exit_code = compile_file(input_paths[i], output_paths[i], opts,
+                                             {res.out, res.log, res.err});
+            }
+        };
+
+        vector<thread> threads;
+        for (unsigned i = 0; i < std::min<size_t>(jobs, input_paths.size()); i++)
+            threads.emplace_back(worker);
+        for (auto &t: threads)
+            t.join();
+
+        int exit_code = exitCode(ReturnValue::Success);
+        for (size_t i = 0; i < input_paths.size(); i++) {
+            FileResult &res = results[i];
+            cout << res.out.str();
+            if (!res.log.str().empty() || !res.err.str().empty()) {
+                cerr << input_paths[i] << ":" << endl;
+                cerr << res.log.str() << res.err.str();
+            }
+            if (exit_code == exitCode(ReturnValue::Success))
+                exit_code = res.exit_code;
+        }
+        return exit_code;
+    }
+}
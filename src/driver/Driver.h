@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "optimizer/Optimizer.h"
+#include "emitter/Emitter.h"
+#include "utils/Context.h"
+
+namespace cpm::driver {
+    enum class ReturnValue : int32_t {
+        Success = EXIT_SUCCESS,
+        Failure = EXIT_FAILURE,
+        FileNotFound = 2,
+        FileOpen = 2,
+        AntlrSyntaxError = 3,
+        AntlrVisitError = 4,
+        ScVisitError = 5,
+    };
+
+    inline int exitCode(ReturnValue ret) {
+        return static_cast<std::underlying_type_t<ReturnValue>>(ret);
+    }
+
+    /**
+     * Options that affect the compilation of a single file.
+     */
+    struct CompileOptions {
+        cpm::OptLevel opt_level = cpm::OptLevel::O0;
+        cpm::EmitKind emit_kind = cpm::EmitKind::LLVMIR;
+        bool ast_dump_raw = false;
+        bool ast_dump = false;
+        bool run = false;
+        bool time = false;
+        // report statistics about the compilation
+        bool stats = false;
+        // don't name the llvm values, only globals keep their names
+        bool discard_value_names = false;
+        // semantic analysis stops after this many errors, 0 for no limit
+        uint32_t max_errors = 20;
+        // number of threads that check the function bodies in semantic analysis
+        uint32_t sema_threads = 1;
+        // number of threads that generate the function bodies in llvm ir
+        uint32_t codegen_threads = 1;
+        // build ssa form of the local variables directly, see cpm::CodegenOptions
+        bool ssa_locals = false;
+        // the file is the whole program, see cpm::CodegenOptions; implied by 'run'
+        bool whole_program = false;
+    };
+
+    /**
+     * Where the compilation of a single file writes to.
+     */
+    struct CompileStreams {
+        // output (ir, ast dump, ...) when there's no output file
+        std::ostream &out;
+        // warnings and other messages
+        std::ostream &log;
+        // errors
+        std::ostream &err;
+    };
+
+    /**
+     * Compile C+- source code read from 'input'.
+     *
+     * Everything the compilation needs (context, parser, checker, builder, ...) is
+     * created here, so multiple sources can be compiled in parallel.
+     * @param output_path  output file, the output goes to 'streams.out' if not set
+     * @return the exit code
+     */
+    int compile(std::istream &input, const std::optional<std::string> &output_path,
+                const CompileOptions &opts, CompileStreams streams);
+
+    /**
+     * Same as compile(), but the source code is already loaded in the context.
+     */
+    int compile(cpm::Context &context, const std::optional<std::string> &output_path,
+                const CompileOptions &opts, CompileStreams streams);
+
+    /**
+     * Same as compile(), but reads the source code from a file.
+     *
+     * The file is mapped into memory, the source code is never copied.
+     */
+    int compile_file(const std::string &input_path, const std::optional<std::string> &output_path,
+                     const CompileOptions &opts, CompileStreams streams);
+
+    /**
+     * Compile multiple files on 'jobs' worker threads.
+     *
+     * Each file is compiled into its own output file next to the input file, with
+     * the extension of the output kind; inputs that would share an output file are
+     * rejected before anything is compiled.
+     * The reports are buffered and printed in the order of input files once all
+     * files are compiled, so the output doesn't depend on the number of jobs.
+     * @return exit code of the first file (in input order) that failed, or success
+     */
+    int compile_batch(const std::vector<std::string> &input_paths, const CompileOptions &opts,
+                      unsigned jobs);
+
+    /**
+     * File extension of the output of given kind, e.g. ".o" for object files.
+     */
+    std::string output_extension(cpm::EmitKind kind);
+}
@@ -0,0 +1,125 @@
+#include "Emitter.h"
+
+#include <mutex>
+#include <stdexcept>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetOptions.h>
+
+using namespace std;
+
+namespace cpm {
+    namespace {
+        void initialize_native_target() {
+            static std::once_flag flag;
+            std::call_once(flag, [] {
+                llvm::InitializeNativeTarget();
+                llvm::InitializeNativeTargetAsmPrinter();
+                llvm::InitializeNativeTargetAsmParser();
+            });
+        }
+
+        llvm::CodeGenOpt::Level codegen_opt_level(OptLevel level) {
+            switch (level) {
+                case OptLevel::O0:
+                    return llvm::CodeGenOpt::None;
+                case OptLevel::O1:
+                    return llvm::CodeGenOpt::Less;
+                case OptLevel::O2:
+                    return llvm::CodeGenOpt::Default;
+                case OptLevel::O3:
+                    return llvm::CodeGenOpt::Aggressive;
+            }
+            return llvm::CodeGenOpt::Default;
+        }
+
+        std::string host_cpu_features() {
+            llvm::SubtargetFeatures features;
+            llvm::StringMap<bool> host_features;
+            if (llvm::sys::getHostCPUFeatures(host_features))
+                for (const auto &f: host_features)
+                    features.AddFeature(f.first(), f.second);
+            return features.getString();
+        }
+    }
+
+    Emitter::Emitter(EmitKind kind, OptLevel level) :
+            kind(kind) {
+        initialize_native_target();
+
+        std::string triple = llvm::sys::getDefaultTargetTriple();
+        std::string error;
+        const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+        if (!target)
+            throw std::runtime_error("Emitter: " + error);
+
+        llvm::TargetOptions options;
+        // executables are position independent by default on most systems
+        target_machine.reset(target->createTargetMachine(triple,
+                                                         llvm::sys::getHostCPUName(),
+                                                         host_cpu_features(),
+                                                         options,
+                                                         llvm::Reloc::PIC_,
+                                                         llvm::None,
+                                                         codegen_opt_level(level)));
+        if (!target_machine)
+            throw std::runtime_error("Emitter: couldn't create target machine for " + triple);
+    }
+
+    void Emitter::prepareModule(llvm::Module &module) const {
+        module.setTargetTriple(target_machine->getTargetTriple().str());
+        module.setDataLayout(target_machine->createDataLayout());
+    }
+
+    void Emitter::run(llvm::Module &module, std::ostream &os) {
+        llvm::SmallVector<char, 0> buffer;
+        llvm::raw_svector_ostream buffer_os(buffer);
+
+        switch (kind) {
+            case EmitKind::LLVMIR:
+                module.print(buffer_os, nullptr);
+                break;
+            case EmitKind::Bitcode:
+                llvm::WriteBitcodeToFile(module, buffer_os);
+                break;
+            case EmitKind::Assembly:
+            case EmitKind::Object: {
+                auto file_type = kind == EmitKind::Object ? llvm::CGFT_ObjectFile
+                                                          : llvm::CGFT_AssemblyFile;
+                llvm::legacy::PassManager pm;
+                // returns true if the file type is not supported
+                if (target_machine->addPassesToEmitFile(pm, buffer_os, nullptr, file_type))
+                    throw std::runtime_error("Emitter: target can't emit this file type");
+                pm.run(module);
+                break;
+            }
+        }
+
+        os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+
+    EmitKind Emitter::parseKind(const std::string &name) {
+        if (name == "ll")
+            return EmitKind::LLVMIR;
+        else if (name == "bc")
+            return EmitKind::Bitcode;
+        else if (name == "asm")
+            return EmitKind::Assembly;
+        else if (name == "obj")
+            return EmitKind::Object;
+        throw std::invalid_argument("unknown emit kind '" + name + "', expected ll, bc, asm or obj");
+    }
+
+    bool Emitter::is_binary(EmitKind kind) {
+        return kind == EmitKind::Bitcode || kind == EmitKind::Object;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include "optimizer/Optimizer.h"
+
+namespace cpm {
+    /**
+     * Output formats the module can be emitted in.
+     */
+    enum class EmitKind {
+        // textual llvm ir
+        LLVMIR,
+        // llvm bitcode
+        Bitcode,
+        // native assembly
+        Assembly,
+        // native object file
+        Object
+    };
+
+    /**
+     * Emits a module in one of EmitKind formats, in-process.
+     *
+     * Native code is generated for the host by llvm TargetMachine.
+     */
+    class Emitter {
+    public:
+        /**
+         * Create an emitter for the host target.
+         *
+         * Throws std::runtime_error if the host target is not available.
+         * @param level  optimization level used by the code generator
+         */
+        explicit Emitter(EmitKind kind, OptLevel level = OptLevel::O0);
+
+        /**
+         * Set target triple and data layout of the host to the module.
+         *
+         * Should be called before the module is optimized, so that the
+         * optimizer knows the target.
+         */
+        void prepareModule(llvm::Module &module) const;
+
+        /**
+         * Emit the module to given stream.
+         *
+         * Throws std::runtime_error if the target can't emit the file type.
+         */
+        void run(llvm::Module &module, std::ostream &os);
+
+        EmitKind getKind() const {
+            return kind;
+        }
+
+        llvm::TargetMachine *getTargetMachine() const {
+            return target_machine.get();
+        }
+
+        /**
+         * Parse the emit kind from its command line name: ll, bc, asm or obj.
+         *
+         * Throws std::invalid_argument for unknown names.
+         */
+        static EmitKind parseKind(const std::string &name);
+
+        /**
+         * Returns true if the output of given kind is binary.
+         */
+        static bool is_binary(EmitKind kind);
+
+    private:
+        EmitKind kind;
+        std::unique_ptr<llvm::TargetMachine> target_machine;
+    };
+}
@@ -0,0 +1,67 @@
+#include "Jit.h"
+
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+
+using namespace std;
+
+namespace cpm {
+    namespace {
+        /**
+         * Turn llvm::Error into std::runtime_error.
+         */
+        void throw_on_error(llvm::Error err) {
+            if (err)
+                throw std::runtime_error("Jit: " + llvm::toString(std::move(err)));
+        }
+
+        template<typename T>
+        T throw_on_error(llvm::Expected<T> expected) {
+            throw_on_error(expected.takeError());
+            return std::move(*expected);
+        }
+    }
+
+    Jit::Jit() {
+        static std::once_flag flag;
+        std::call_once(flag, [] {
+            llvm::InitializeNativeTarget();
+            llvm::InitializeNativeTargetAsmPrinter();
+            llvm::InitializeNativeTargetAsmParser();
+        });
+    }
+
+    int Jit::run(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module) {
+        // LLJIT sets up the generic ir platform, which takes care of 'llvm.global_ctors'
+        // in initialize() and 'llvm.global_dtors' in deinitialize()
+        std::unique_ptr<llvm::orc::LLJIT> jit = throw_on_error(llvm::orc::LLJITBuilder().create());
+        llvm::orc::JITDylib &main_dylib = jit->getMainJITDylib();
+
+        // resolve library functions (printf, scanf, malloc, ...) from this process
+        main_dylib.addGenerator(throw_on_error(
+                llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                        jit->getDataLayout().getGlobalPrefix())));
+
+        throw_on_error(jit->addIRModule(
+                llvm::orc::ThreadSafeModule(std::move(module), std::move(context))));
+
+        auto main_sym = throw_on_error(jit->lookup("main"));
+        auto *main_func = reinterpret_cast<int (*)()>(main_sym.getAddress());
+
+        throw_on_error(jit->initialize(main_dylib));
+        int ret = main_func();
+        throw_on_error(jit->deinitialize(main_dylib));
+
+        // the program's output is buffered by the C library, flush it before the
+        // compiler writes anything else
+        std::fflush(stdout);
+        return ret;
+    }
+}
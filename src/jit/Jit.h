@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+namespace cpm {
+    /**
+     * Runs a module in-process with the ORC LLJIT.
+     *
+     * The program shares stdin, stdout and stderr with the compiler. Functions
+     * declared but not defined in the module (printf, malloc, ...) are resolved
+     * from the compiler process, that is, from the C library.
+     */
+    class Jit {
+    public:
+        Jit();
+
+        /**
+         * JIT-compile the module and run its 'main' function.
+         *
+         * Global constructors registered in 'llvm.global_ctors' are run
+         * before main.
+         *
+         * Throws std::runtime_error if the module can't be compiled or
+         * doesn't contain 'main'.
+         * @return value returned from 'main'
+         */
+        int run(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module);
+    };
+}
@@ -1,8 +1,48 @@
 #include "LLBuilder.h"
 
+#include <exception>
+#include <thread>
+
+#include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "utils/Statistic.h"
+
 using namespace std;
 using namespace cpm;
 
+namespace {
+    cpm::Statistic num_type_lowerings("llbuilder", "type-lowerings",
+                                      "cpm types lowered to llvm types");
+    cpm::Statistic num_type_cache_hits("llbuilder", "type-cache-hits",
+                                       "type lowerings answered from the cache");
+    cpm::Statistic num_shards("llbuilder", "shards",
+                              "modules generated on worker threads and linked together");
+    cpm::Statistic num_constant_globals("llbuilder", "constant-initializers",
+                                        "global variables initialized by a constant");
+    cpm::Statistic num_dynamic_globals("llbuilder", "dynamic-initializers",
+                                       "global variables initialized before main");
+    cpm::Statistic num_dead_branches("llbuilder", "dead-branches",
+                                     "statements not generated because of a constant condition");
+    cpm::Statistic num_internalized_functions("llbuilder", "internalized-functions",
+                                              "functions given internal linkage");
+
+    bool is_const_type(cpm::Type *type) {
+        if (cpm::SimpleType *st = cpm::simple_ty(type))
+            return st->isConst();
+        else if (cpm::PointerType *pt = cpm::pointer_ty(type))
+            return pt->isConst();
+        return false;
+    }
+}
+
 void LLBuilder::operator()(const ast::DeclarStmt &node) {
     codegen(*node.declaration);
 }
@@ -15,12 +55,14 @@ void LLBuilder::operator()(const ast::ExprStmt &node) {
 void LLBuilder::operator()(const ast::BreakStmt &node) {
     // break_level=1 will result in break_bbs.back()
     llvm::BasicBlock *bb = break_bbs.at(break_bbs.size() - node.break_level);
+    end_lifetimes(loop_scope_depths.at(loop_scope_depths.size() - node.break_level));
     builder.CreateBr(bb);
 }
 
 void LLBuilder::operator()(const ast::ContinueStmt &node) {
     // continue_level=1 will result in continue_bbs.back()
     llvm::BasicBlock *bb = continue_bbs.at(continue_bbs.size() - node.continue_level);
+    end_lifetimes(loop_scope_depths.at(loop_scope_depths.size() - node.continue_level));
     builder.CreateBr(bb);
 }
 
@@ -31,15 +73,18 @@ void LLBuilder::operator()(const ast::ReturnStmt &node) {
     if (node.expr.has_value()) {
         llvm::Value *ret_expr = codegen(*node.expr.value());
         if (ret_type != builder.getVoidTy())
-            builder.CreateStore(ret_expr, ret_val);
+            create_store(ret_expr, ret_val);
     }
+    end_lifetimes(0);
     builder.CreateBr(return_bb);
     // CreateRet instruction is called when visiting ast::FuncDef
 }
 
 void LLBuilder::operator()(const ast::CompoundStmt &node) {
+    push_scope();
     for (const auto &stmt: node.statements)
         codegen(*stmt);
+    pop_scope();
 }
 
 void LLBuilder::operator()(const ast::DoWhileStmt &node) {
@@ -53,7 +98,8 @@ void LLBuilder::operator()(const ast::DoWhileStmt &node) {
     // save basic blocks for 'break' and 'continue'
     break_bbs.push_back(end);
     continue_bbs.push_back(cond);
-    // generate body
+    loop_scope_depths.push_back(scope_slots.size());
+    // generate body, the condition jumps back to it
     builder.CreateBr(body);
     builder.SetInsertPoint(body);
     codegen(*node.body);
@@ -63,16 +109,20 @@ void LLBuilder::operator()(const ast::DoWhileStmt &node) {
         builder.CreateBr(cond);
     // generate condition
     llvm_func->getBasicBlockList().push_back(cond);
+    seal_block(cond);
     builder.SetInsertPoint(cond);
     llvm::Value *cond_val = codegen(*node.cond);
     builder.CreateCondBr(cond_val, body, end);
+    seal_block(body);
     // generate end
     llvm_func->getBasicBlockList().push_back(end);
+    seal_block(end);
     builder.SetInsertPoint(end);
 
     // cleanup
     break_bbs.pop_back();
     continue_bbs.pop_back();
+    loop_scope_depths.pop_back();
 }
 
 llvm::Function *LLBuilder::getCurrentFunction() {
@@ -94,15 +144,19 @@ void LLBuilder::operator()(const ast::ForStmt &node) {
     // add bbs for break and continue
     break_bbs.push_back(end);
     continue_bbs.push_back(post_iter);
+    // the variables of the init statement live until the end of the loop
+    push_scope();
+    loop_scope_depths.push_back(scope_slots.size());
     // generate preloop
     builder.CreateBr(preloop);
+    seal_block(preloop);
     builder.SetInsertPoint(preloop);
     codegen(*node.initStmt);
     //      forInitStmt shouldn't be able
     //      to create a terminator, no need to check
     //      for that then
     builder.CreateBr(cond);
-    // generate cond
+    // generate cond, post_iter jumps back to it
     builder.SetInsertPoint(cond);
     if (node.cond.has_value()) {
         llvm::Value *cond_val = codegen(*node.cond.value());
@@ -110,6 +164,7 @@ void LLBuilder::operator()(const ast::ForStmt &node) {
     } else
         builder.CreateBr(body);
     // generate body
+    seal_block(body);
     builder.SetInsertPoint(body);
     codegen(*node.body);
     // the body might contain return, break or something -> in that case we don't
@@ -118,10 +173,12 @@ void LLBuilder::operator()(const ast::ForStmt &node) {
         builder.CreateBr(post_iter);
     // generate post_iter
     curr_func->getBasicBlockList().push_back(post_iter);
+    seal_block(post_iter);
     builder.SetInsertPoint(post_iter);
     if (node.post_iter.has_value())
         codegen(*node.post_iter.value());
     builder.CreateBr(cond);
+    seal_block(cond);
     // generate end
     curr_func->getBasicBlockList().push_back(end);
     // if the 'end' block is not referred, delete it;
@@ -129,12 +186,16 @@ void LLBuilder::operator()(const ast::ForStmt &node) {
     // and a return inside the loop body
     if (llvm::pred_empty(end))
         end->eraseFromParent();
-    else
+    else {
+        seal_block(end);
         builder.SetInsertPoint(end);
+    }
+    pop_scope();
 
     // cleanup
     break_bbs.pop_back();
     continue_bbs.pop_back();
+    loop_scope_depths.pop_back();
 }
 
 llvm::Value *LLBuilder::operator()(const ast::BinaryExpr &node) {
@@ -263,7 +324,7 @@ llvm::Value *LLBuilder::create_binary_op(llvm::Value *lhs, llvm::Value *rhs, ast
                 return convert(builder.CreatePtrDiff(lhs_ty->getPointerElementType(),
                                                      lhs,
                                                      rhs),
-                               types.at("int"));
+                               getBuiltinType(cpm::SimpleType::Builtin::Int));
             default:
                 break;
         }
@@ -272,11 +333,23 @@ llvm::Value *LLBuilder::create_binary_op(llvm::Value *lhs, llvm::Value *rhs, ast
 }
 
 llvm::Value *LLBuilder::operator()(const ast::NullptrLiteral &) {
-    return llvm::Constant::getNullValue(types.at("nullptr_t"));
+    return llvm::Constant::getNullValue(getBuiltinType(cpm::SimpleType::Builtin::Nullptr));
 }
 
 llvm::Value *LLBuilder::operator()(const ast::IntLiteral &node) {
-    return llvm::ConstantInt::get(types.at("int"), node.val, true);
+    return llvm::ConstantInt::get(getBuiltinType(cpm::SimpleType::Builtin::Int), node.val, true);
+}
+
+llvm::Value *LLBuilder::operator()(const ast::ConstantExpr &node) {
+    // the expression itself is not generated, it has no side effects
+    llvm::Type *type = getBuiltinType(node.value.type);
+    if (node.value.type == cpm::SimpleType::Builtin::Double)
+        return llvm::ConstantFP::get(type, node.value.double_val);
+    return llvm::ConstantInt::get(type, node.value.int_val, true);
+}
+
+const ast::ConstantExpr *LLBuilder::constant_condition(const ast::Condition &cond) {
+    return get_if<ast::ConstantExpr>(cond.expr.get());
 }
 
 llvm::Value *LLBuilder::operator()(const ast::AssignmentExpr &node) {
@@ -296,7 +369,7 @@ llvm::Value *LLBuilder::operator()(const ast::AssignmentExpr &node) {
         llvm::Value *op_res = create_binary_op(lhs_converted, rhs, op);
         assigned_val = convert(op_res, lhs_rvalue->getType());
     }
-    builder.CreateStore(assigned_val, lhs);
+    create_store(assigned_val, lhs);
 
     // return the lvalue
     return lhs;
@@ -323,12 +396,14 @@ llvm::Value *LLBuilder::create_shortcircuit(const ast::BinaryExpr &node) {
     llvm::Value *eval_rhs = node.op == ast::LogicalAnd ? lhs : builder.CreateNot(lhs);
     builder.CreateCondBr(eval_rhs, rhs_bb, end_bb);
     // generate rhs
+    seal_block(rhs_bb);
     builder.SetInsertPoint(rhs_bb);
     llvm::Value *rhs = codegen(*node.rhs);
     // rhs could've also generated more basic blocks
     rhs_bb = builder.GetInsertBlock();
     builder.CreateBr(end_bb);
     // generate end
+    seal_block(end_bb);
     builder.SetInsertPoint(end_bb);
     llvm::PHINode *phi_node = builder.CreatePHI(builder.getInt1Ty(), 2);
     phi_node->addIncoming(lhs, lhs_bb);
@@ -337,6 +412,15 @@ llvm::Value *LLBuilder::create_shortcircuit(const ast::BinaryExpr &node) {
 }
 
 void LLBuilder::operator()(const ast::IfStmt &node) {
+    // only the branch that's taken is generated, in the current block
+    if (const ast::ConstantExpr *cond = constant_condition(*node.cond)) {
+        if (cond->value.int_val)
+            codegen(*node.body);
+        else if (node.else_body.has_value())
+            codegen(*node.else_body.value());
+        ++num_dead_branches;
+        return;
+    }
     std::string line_no = std::to_string(node.src_info.line_no);
     llvm::Function *llvm_func = builder.GetInsertBlock()->getParent();
     llvm::BasicBlock
@@ -348,10 +432,12 @@ void LLBuilder::operator()(const ast::IfStmt &node) {
 
     // generate condition
     builder.CreateBr(cond);
+    seal_block(cond);
     builder.SetInsertPoint(cond);
     llvm::Value *cond_val = codegen(*node.cond);
     builder.CreateCondBr(cond_val, then, else_);
     // generate then
+    seal_block(then);
     builder.SetInsertPoint(then);
     codegen(*node.body);
     // body can contain return, break or something
@@ -359,6 +445,7 @@ void LLBuilder::operator()(const ast::IfStmt &node) {
         builder.CreateBr(if_end);
     // generate else
     llvm_func->getBasicBlockList().push_back(else_);
+    seal_block(else_);
     builder.SetInsertPoint(else_);
     if (node.else_body.has_value())
         codegen(*node.else_body.value());
@@ -372,11 +459,19 @@ void LLBuilder::operator()(const ast::IfStmt &node) {
     // inside both the body and the else_body
     if (llvm::pred_empty(if_end))
         if_end->eraseFromParent();
-    else
+    else {
+        seal_block(if_end);
         builder.SetInsertPoint(if_end);
+    }
 }
 
 void LLBuilder::operator()(const ast::WhileStmt &node) {
+    // the body is never run
+    if (const ast::ConstantExpr *cond = constant_condition(*node.cond);
+            cond && !cond->value.int_val) {
+        ++num_dead_branches;
+        return;
+    }
     string line_no = std::to_string(node.src_info.line_no);
     llvm::BasicBlock *cond = newBB("while.cond_" + line_no);
     llvm::BasicBlock *body = newBB("while.body" + line_no);
@@ -384,24 +479,29 @@ void LLBuilder::operator()(const ast::WhileStmt &node) {
 
     break_bbs.push_back(end);
     continue_bbs.push_back(cond);
+    loop_scope_depths.push_back(scope_slots.size());
 
-    // start by going to condition
+    // start by going to condition, the body jumps back to it
     builder.CreateBr(cond);
     // generate condition
     builder.SetInsertPoint(cond);
     llvm::Value *cond_val = codegen(*node.cond);
     builder.CreateCondBr(cond_val, body, end);
     // generate body
+    seal_block(body);
     builder.SetInsertPoint(body);
     codegen(*node.body);
     // body can contain return, break or something
     if (!builder.GetInsertBlock()->getTerminator())
         builder.CreateBr(cond);
+    seal_block(cond);
     // generate end
+    seal_block(end);
     builder.SetInsertPoint(end);
     // cleanup
     break_bbs.pop_back();
     continue_bbs.pop_back();
+    loop_scope_depths.pop_back();
 }
 
 llvm::Value *LLBuilder::operator()(const ast::Condition &node) {
@@ -421,6 +521,8 @@ llvm::Value *LLBuilder::operator()(const ast::UnaryExpr &node) {
     switch (node.op) {
         // we're holding lvalue, which is represented by pointer in llvm
         case ast::UnAnd:
+            check(!is_ssa_var(val), "taking address of a variable in ssa registers");
+            return val;
         // we're holding rvalue of llvm pointer type
         case ast::UnStar:
         // unary plus is just the value
@@ -429,7 +531,7 @@ llvm::Value *LLBuilder::operator()(const ast::UnaryExpr &node) {
         case ast::PlusPlus:
         case ast::MinusMinus: {
             llvm::Value *new_val = incr_decr(val, node.op == ast::PlusPlus);
-            builder.CreateStore(new_val, val);
+            create_store(new_val, val);
             // return the original lvalue
             return val;
         }
@@ -468,7 +570,7 @@ llvm::Value *LLBuilder::operator()(const ast::PostIncrExpr &node) {
     llvm::Value *old_val = create_load(lvalue);
     // do the increment
     llvm::Value *new_val = incr_decr(lvalue, node.incr);
-    builder.CreateStore(new_val, lvalue);
+    create_store(new_val, lvalue);
     // return the old value
     return old_val;
 }
@@ -490,8 +592,19 @@ void LLBuilder::operator()(const ast::InitDeclarator &node) {
     const string &id = decl->id;
     llvm::Type *type = get_llvm_type(decl->type);
     llvm::Value *val;
+    // global scope, defined by another module
+    if (!getCurrentFunction() && part == Part::Declarations) {
+        vals[decl] = new llvm::GlobalVariable(
+                module,
+                type,
+                false,
+                llvm::GlobalValue::ExternalLinkage,
+                nullptr,
+                "global_" + id);
+        return;
+    }
     // global scope
-    if (!getCurrentFunction())
+    else if (!getCurrentFunction())
         val = new llvm::GlobalVariable(
                 module,
                 type,
@@ -499,23 +612,39 @@ void LLBuilder::operator()(const ast::InitDeclarator &node) {
                 llvm::GlobalValue::ExternalLinkage,
                 llvm::Constant::getNullValue(type),
                 "global_" + id);
-    // local scope
-    else
-        val = builder.CreateAlloca(type, nullptr, id);
+    // local scope, the slot is in the entry block, but the variable lives from here
+    else {
+        llvm::AllocaInst *slot = create_local(type, decl, id);
+        start_lifetime(slot);
+        // a new variable each time the declaration runs, e.g. in a loop
+        if (is_ssa_var(slot) && !node.initializer)
+            write_variable(slot, builder.GetInsertBlock(), llvm::UndefValue::get(type));
+        val = slot;
+    }
     // save the value
     vals[decl] = val;
 
     if (node.initializer) {
         // global scope
         if (!getCurrentFunction())
-            initialize_global_var(val, *node.initializer.value());
+            initialize_global_var(llvm::cast<llvm::GlobalVariable>(val), *node.initializer.value(),
+                                  is_const_type(decl->type));
         // local scope
         else
-            builder.CreateStore(codegen(*node.initializer.value()), val);
+            create_store(codegen(*node.initializer.value()), val);
     }
 }
 
 void LLBuilder::operator()(const ast::FuncDef &node) {
+    if (part != Part::All) {
+        getFunction(*node.declarator);
+        bodies.push_back(&node);
+        return;
+    }
+    define_function(node);
+}
+
+void LLBuilder::define_function(const ast::FuncDef &node) {
     llvm::Function *func = getFunction(*node.declarator);
     llvm::Type *ret_ty = func->getReturnType();
 
@@ -524,15 +653,17 @@ void LLBuilder::operator()(const ast::FuncDef &node) {
 
     // get into the function body
     llvm::BasicBlock *entry = llvm::BasicBlock::Create(context, "entry", func);
+    seal_block(entry);
     builder.SetInsertPoint(entry);
+    last_alloca = nullptr;
 
     // prepare the return_bb and ret_val alloca for non-void functions
     return_bb = llvm::BasicBlock::Create(context, "return");
     if (!ret_ty->isVoidTy()) {
-        ret_val = builder.CreateAlloca(ret_ty, nullptr, "ret_val");
+        ret_val = create_local(ret_ty, nullptr, "ret_val");
         if (node.declarator->id == "main")
             // implicit return of 0
-            builder.CreateStore(llvm::Constant::getNullValue(func->getReturnType()), ret_val);
+            create_store(llvm::Constant::getNullValue(func->getReturnType()), ret_val);
     }
 
     // handle parameters
@@ -549,8 +680,9 @@ void LLBuilder::operator()(const ast::FuncDef &node) {
         }
 
         // create alloca for the argument and store the initial value there
-        llvm::AllocaInst *alloca = builder.CreateAlloca(arg->getType(), nullptr, name + ".addr");
-        builder.CreateStore(arg, alloca);
+        llvm::AllocaInst *alloca = create_local(arg->getType(), params[i]->declarator.get(),
+                                                name + ".addr");
+        create_store(arg, alloca);
         // save the alloca in vals so that it can be referred to in the function body
         vals[params[i]->declarator.get()] = alloca;
     }
@@ -564,6 +696,7 @@ void LLBuilder::operator()(const ast::FuncDef &node) {
 
     // add return_bb to the end of function, and create the return instruction
     func->getBasicBlockList().push_back(return_bb);
+    seal_block(return_bb);
     builder.SetInsertPoint(return_bb);
     if (ret_ty->isVoidTy())
         builder.CreateRetVoid();
@@ -573,8 +706,11 @@ void LLBuilder::operator()(const ast::FuncDef &node) {
     }
 
     // cleanup
+    check(scope_slots.empty());
+    finish_ssa();
     return_bb = nullptr;
     ret_val = nullptr;
+    last_alloca = nullptr;
     this_lval = nullptr;
     this_rval = nullptr;
     builder.ClearInsertionPoint();
@@ -602,15 +738,24 @@ llvm::Function *LLBuilder::getFunction(const ast::FunctionDecl &node) {
     // save the function for other declarations
     functions[&node] = func;
 
+    // c+- has no exceptions, the rest is from the semantic checker
+    func->setDoesNotThrow();
+    if (node.memory == ast::MemoryEffect::None)
+        func->setDoesNotAccessMemory();
+    else if (node.memory == ast::MemoryEffect::Read)
+        func->setOnlyReadsMemory();
+    if (node.norecurse)
+        func->setDoesNotRecurse();
+
     // set parameter names with the first declaration
     for (size_t i = 0; i < node.params.size(); i++)
-        func->getArg(i)->setName(node.params.at(i)->declarator->id);
+        func->getArg(i)->setName(node.params.at(i)->declarator->id.str());
 
     return func;
 }
 
 llvm::Value *LLBuilder::operator()(const ast::CharLiteral &node) {
-    return llvm::ConstantInt::get(types.at("char"), node.c, true);
+    return llvm::ConstantInt::get(getBuiltinType(cpm::SimpleType::Builtin::Char), node.c, true);
 }
 
 llvm::Value *LLBuilder::operator()(const ast::ThisExpr &) {
@@ -618,15 +763,16 @@ llvm::Value *LLBuilder::operator()(const ast::ThisExpr &) {
 }
 
 llvm::Value *LLBuilder::operator()(const ast::BoolLiteral &node) {
-    return llvm::ConstantInt::get(types.at("bool"), node.val, true);
+    return llvm::ConstantInt::get(getBuiltinType(cpm::SimpleType::Builtin::Bool), node.val, true);
 }
 
 llvm::Value *LLBuilder::operator()(const ast::FloatLiteral &node) {
-    return llvm::ConstantFP::get(types.at("double"), llvm::APFloat(node.val));
+    return llvm::ConstantFP::get(getBuiltinType(cpm::SimpleType::Builtin::Double), llvm::APFloat(node.val));
 }
 
 llvm::Value *LLBuilder::operator()(const ast::StringLiteral &node) {
-    return builder.CreateGlobalString(node.str);
+    // the module is given explicitly, global initializers aren't generated in a function
+    return builder.CreateGlobalString(node.str, "", 0, &module);
 }
 
 void LLBuilder::operator()(const ast::EmptyDeclaration &) {
@@ -646,18 +792,11 @@ void LLBuilder::operator()(const ast::FuncBody &node) {
 void LLBuilder::operator()(const ast::TranslationUnit &node) {
     for (const auto &d: node.declars)
         codegen(*d);
-    // finish global constructors function if it exists
-    if (global_ctors_func) {
-        builder.SetInsertPoint(&global_ctors_func->back());
-        builder.CreateRetVoid();
-    }
-    delete_unused_declarations();
 }
 
 llvm::Value *LLBuilder::operator()(const ast::CallExpr &node) {
     check(node.func.value());
     llvm::Function *func = functions.at(node.func.value());
-    called_functions.insert(func);
 
     vector<llvm::Value *> arg_vals;
     if (const ast::MemberAccessExpr *method_call = get_if<ast::MemberAccessExpr>(
@@ -669,8 +808,11 @@ llvm::Value *LLBuilder::operator()(const ast::CallExpr &node) {
     if (node.ctor_call) {
         auto *id_expr = get_if<ast::IdExpr>(node.called_func.get());
         check(id_expr);
-        llvm::Type *class_type = types.at(id_expr->id);
-        llvm::AllocaInst *this_alloca = builder.CreateAlloca(class_type, nullptr, "ctor_this");
+        llvm::Type *class_type = class_types.at(id_expr->id);
+        // the temporary object only lives until it's loaded below
+        llvm::AllocaInst *this_alloca = create_entry_alloca(class_type, "ctor_this");
+        if (opts.lifetime_markers)
+            builder.CreateLifetimeStart(this_alloca);
         arg_vals.push_back(this_alloca);
     }
     for (const ast::node_ptr<ast::Expr> &arg: node.args)
@@ -679,7 +821,12 @@ llvm::Value *LLBuilder::operator()(const ast::CallExpr &node) {
     llvm::Value *returned_val = builder.CreateCall(func, arg_vals);
     // calls should always return rvalue, that's why we load from
     // the ctor alloca
-    return node.ctor_call ? create_load(arg_vals[0]) : returned_val;
+    if (!node.ctor_call)
+        return returned_val;
+    llvm::Value *object = create_load(arg_vals[0]);
+    if (opts.lifetime_markers)
+        builder.CreateLifetimeEnd(arg_vals[0]);
+    return object;
 }
 
 llvm::Value *LLBuilder::operator()(const ast::SubscriptExpr &node) {
@@ -699,18 +846,24 @@ llvm::Value *LLBuilder::operator()(const ast::TernaryExpr &node) {
     llvm::Value *cond_val = codegen(*node.cond);
     builder.CreateCondBr(cond_val, then_bb, else_bb);
     // generate then
+    seal_block(then_bb);
     builder.SetInsertPoint(then_bb);
     llvm::Value *then_val = codegen(*node.then);
+    // lvalue branches are merged as addresses, sema keeps such variables in memory
+    check(!is_ssa_var(then_val), "lvalue of a variable in ssa registers in ternary operator");
     // basic block could've changed (if then contained && for example)
     then_bb = builder.GetInsertBlock();
     builder.CreateBr(end_bb);
     // generate else
+    seal_block(else_bb);
     builder.SetInsertPoint(else_bb);
     llvm::Value *else_val = codegen(*node.else_);
+    check(!is_ssa_var(else_val), "lvalue of a variable in ssa registers in ternary operator");
     // basic block could've changed during else_val generation
     else_bb = builder.GetInsertBlock();
     builder.CreateBr(end_bb);
     // generate end
+    seal_block(end_bb);
     builder.SetInsertPoint(end_bb);
     // if 'b' and 'c' were void expressions (probably calls to void function),
     // the value is discarded
@@ -724,25 +877,23 @@ llvm::Value *LLBuilder::operator()(const ast::TernaryExpr &node) {
 }
 
 void LLBuilder::class_first_pass(const ast::ClassDef &node) {
-    string name = node.head->name;
+    cpm::Symbol name = node.head->name;
     // this assumes no class forward declarations, namespaces or nested classes
-    check(!types.contains(name), "class redefinition");
+    check(!class_types.contains(name), "class redefinition");
 
-    llvm::StructType *class_type = llvm::StructType::create(context, name);
+    llvm::StructType *class_type = llvm::StructType::create(context, name.str());
     // add the class to list of types before going in body in case of 'S *' member
-    types[name] = class_type;
+    class_types[name] = class_type;
 
     vector<const ast::Decl *> fields;
     if (node.body)
         fields = class_first_pass(*node.body.value());
-    vector<string> names;
+    // the fields are in the order of declaration, the same one the semantic checker
+    // uses for MemberAccessExpr::field_index
     vector<llvm::Type *> field_types;
-    for (const auto &m: fields) {
-        names.push_back(m->id);
+    for (const auto &m: fields)
         field_types.push_back(get_llvm_type(m->type));
-    }
 
-    class_fields[class_type] = names;
     class_type->setBody(field_types);
 }
 
@@ -785,11 +936,27 @@ void LLBuilder::class_second_pass(const ast::MemberSpecification &node) {
 }
 
 llvm::Type *LLBuilder::get_llvm_type(cpm::Type *t) {
-    if (cpm::SimpleType *st = cpm::simple_ty(t))
-        return types.at(st->getTypeId());
+    // types are unique, so they can be cached by the pointer
+    type_lowerings++;
+    auto it = llvm_types.find(t);
+    if (it != llvm_types.end()) {
+        type_cache_hits++;
+        return it->second;
+    }
+    llvm::Type *llvm_type = lower_type(t);
+    llvm_types[t] = llvm_type;
+    return llvm_type;
+}
+
+llvm::Type *LLBuilder::lower_type(cpm::Type *t) {
+    if (cpm::SimpleType *st = cpm::simple_ty(t)) {
+        if (st->isBuiltin(cpm::SimpleType::Builtin::None))
+            return class_types.at(st->getTypeId());
+        return getBuiltinType(st->getBuiltin());
+    }
     else if (cpm::PointerType *pt = cpm::pointer_ty(t)) {
         // special case of 'void*'
-        if (st = cpm::simple_ty(pt->getElemType()); st && st->getTypeId() == "void")
+        if (st = cpm::simple_ty(pt->getElemType()); st && st->isBuiltin(cpm::SimpleType::Builtin::Void))
             return getPtrToVoid();
         return llvm::PointerType::get(get_llvm_type(pt->getElemType()), 0);
     } else if (cpm::FunctionType *ft = cpm::function_ty(t)) {
@@ -807,6 +974,189 @@ llvm::Type *LLBuilder::get_llvm_type(cpm::Type *t) {
     compiler_error("get_llvm_type: unhandled case");
 }
 
+llvm::Type *LLBuilder::getBuiltinType(cpm::SimpleType::Builtin builtin) {
+    switch (builtin) {
+        case cpm::SimpleType::Builtin::Int:
+            return builder.getInt32Ty();
+        case cpm::SimpleType::Builtin::Char:
+            return builder.getInt8Ty();
+        case cpm::SimpleType::Builtin::Bool:
+            return builder.getInt1Ty();
+        case cpm::SimpleType::Builtin::Double:
+            return builder.getDoubleTy();
+        case cpm::SimpleType::Builtin::Void:
+            return builder.getVoidTy();
+        case cpm::SimpleType::Builtin::Nullptr:
+            return getPtrToVoid();
+        case cpm::SimpleType::Builtin::None:
+            break;
+    }
+    compiler_error("getBuiltinType: not a builtin type");
+}
+
+llvm::AllocaInst *LLBuilder::create_entry_alloca(llvm::Type *type, const llvm::Twine &name) {
+    llvm::Function *func = getCurrentFunction();
+    check(func);
+    llvm::BasicBlock &entry = func->getEntryBlock();
+    llvm::IRBuilderBase::InsertPointGuard guard(builder);
+    // the allocas are kept together at the start of the entry block, in the order of creation
+    if (last_alloca && last_alloca->getParent() == &entry)
+        builder.SetInsertPoint(&entry, std::next(last_alloca->getIterator()));
+    else
+        builder.SetInsertPoint(&entry, entry.getFirstInsertionPt());
+    last_alloca = builder.CreateAlloca(type, nullptr, name);
+    return last_alloca;
+}
+
+void LLBuilder::push_scope() {
+    scope_slots.emplace_back();
+}
+
+void LLBuilder::pop_scope() {
+    check(!scope_slots.empty());
+    llvm::BasicBlock *bb = builder.GetInsertBlock();
+    if (bb && !bb->getTerminator())
+        end_lifetimes(scope_slots.size() - 1);
+    scope_slots.pop_back();
+}
+
+void LLBuilder::start_lifetime(llvm::AllocaInst *slot) {
+    // variables in ssa registers have no slot
+    if (!opts.lifetime_markers || is_ssa_var(slot))
+        return;
+    check(!scope_slots.empty());
+    builder.CreateLifetimeStart(slot);
+    scope_slots.back().push_back(slot);
+}
+
+void LLBuilder::end_lifetimes(size_t depth) {
+    if (!opts.lifetime_markers)
+        return;
+    // in the reverse order of declaration
+    for (size_t i = scope_slots.size(); i-- > depth;)
+        for (auto it = scope_slots[i].rbegin(); it != scope_slots[i].rend(); ++it)
+            builder.CreateLifetimeEnd(*it);
+}
+
+llvm::AllocaInst *LLBuilder::create_local(llvm::Type *type, const ast::Decl *decl,
+                                          const llvm::Twine &name) {
+    if (!opts.ssa_locals || !type->isSingleValueType() || (decl && decl->address_taken))
+        return create_entry_alloca(type, name);
+    // the placeholder isn't in any block, it's deleted by finish_ssa
+    auto *var = new llvm::AllocaInst(type, 0, nullptr, module.getDataLayout().getPrefTypeAlign(type),
+                                     name);
+    ssa_vars.insert(var);
+    return var;
+}
+
+void LLBuilder::write_variable(llvm::AllocaInst *var, const llvm::BasicBlock *bb, llvm::Value *val) {
+    current_defs[{bb, var}] = val;
+}
+
+llvm::Value *LLBuilder::read_variable(llvm::AllocaInst *var, llvm::BasicBlock *bb) {
+    auto it = current_defs.find({bb, var});
+    if (it == current_defs.end())
+        return read_variable_recursive(var, bb);
+    // the handle follows the replacements of trivial phis
+    check(it->second, "ssa definition has been deleted");
+    return it->second;
+}
+
+llvm::Value *LLBuilder::read_variable_recursive(llvm::AllocaInst *var, llvm::BasicBlock *bb) {
+    llvm::Type *type = var->getAllocatedType();
+    llvm::Value *val;
+    if (!sealed_blocks.contains(bb)) {
+        // more predecessors may come, the operands are added when the block is sealed
+        llvm::PHINode *phi = create_phi(type, bb, var->getName());
+        incomplete_phis[bb].emplace_back(var, phi);
+        val = phi;
+    }
+    // the entry block, or dead code; the variable is uninitialized
+    else if (llvm::pred_empty(bb))
+        val = llvm::UndefValue::get(type);
+    else if (llvm::BasicBlock *pred = bb->getSinglePredecessor())
+        val = read_variable(var, pred);
+    else {
+        // the phi is defined first, so that loops that lead back here end at it
+        llvm::PHINode *phi = create_phi(type, bb, var->getName());
+        write_variable(var, bb, phi);
+        val = add_phi_operands(var, phi);
+    }
+    write_variable(var, bb, val);
+    return val;
+}
+
+llvm::PHINode *LLBuilder::create_phi(llvm::Type *type, llvm::BasicBlock *bb, const llvm::Twine &name) {
+    // the block may already contain code, the phis must precede it
+    if (llvm::Instruction *first = bb->getFirstNonPHI())
+        return llvm::PHINode::Create(type, 2, name, first);
+    return llvm::PHINode::Create(type, 2, name, bb);
+}
+
+llvm::Value *LLBuilder::add_phi_operands(llvm::AllocaInst *var, llvm::PHINode *phi) {
+    llvm::SmallVector<llvm::BasicBlock *, 4> preds(llvm::predecessors(phi->getParent()));
+    for (llvm::BasicBlock *pred: preds)
+        phi->addIncoming(read_variable(var, pred), pred);
+    return try_remove_trivial_phi(phi);
+}
+
+llvm::Value *LLBuilder::try_remove_trivial_phi(llvm::PHINode *phi) {
+    llvm::Value *same = nullptr;
+    for (llvm::Value *op: phi->incoming_values()) {
+        if (op == same || op == phi)
+            continue;
+        // merges at least two values
+        if (same)
+            return phi;
+        same = op;
+    }
+    // unreachable, or read before the variable was initialized
+    if (!same)
+        same = llvm::UndefValue::get(phi->getType());
+    // the phis that use this one may become trivial as well; they may be removed
+    // while the others are visited, hence the weak handles
+    llvm::SmallVector<llvm::WeakVH, 4> phi_users;
+    for (llvm::User *user: phi->users())
+        if (user != phi && llvm::isa<llvm::PHINode>(user))
+            phi_users.emplace_back(user);
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+    // 'same' itself may be one of them
+    llvm::WeakTrackingVH res = same;
+    for (llvm::WeakVH &handle: phi_users) {
+        auto *user = llvm::dyn_cast_or_null<llvm::PHINode>(handle);
+        // the phis that are still being completed are checked once they are
+        if (user && sealed_blocks.contains(user->getParent()) &&
+            user->getNumIncomingValues() == llvm::pred_size(user->getParent()))
+            try_remove_trivial_phi(user);
+    }
+    return res;
+}
+
+void LLBuilder::seal_block(llvm::BasicBlock *bb) {
+    if (!opts.ssa_locals)
+        return;
+    auto it = incomplete_phis.find(bb);
+    if (it != incomplete_phis.end()) {
+        auto phis = std::move(it->second);
+        incomplete_phis.erase(it);
+        for (const auto &[var, phi]: phis)
+            add_phi_operands(var, phi);
+    }
+    sealed_blocks.insert(bb);
+}
+
+void LLBuilder::finish_ssa() {
+    check(incomplete_phis.empty(), "phis left in an unsealed block");
+    for (const llvm::Value *var: ssa_vars) {
+        check(var->use_empty(), "variable in ssa registers accessed as memory");
+        const_cast<llvm::Value *>(var)->deleteValue();
+    }
+    ssa_vars.clear();
+    current_defs.clear();
+    sealed_blocks.clear();
+}
+
 llvm::BasicBlock *LLBuilder::newBB(const string &name) {
     llvm::Function *func = getCurrentFunction();
     check(func);
@@ -817,23 +1167,19 @@ llvm::Value *LLBuilder::operator()(const ast::MemberAccessExpr &node) {
     llvm::Value *object = codegen(*node.object);
     // object is raw rvalue pointer in case of '->', or lvalue (llvm pointer) in case of '.'
     // -> we can treat like a pointer either way
-    return getField(object, node.member);
+    check(node.field_index.has_value());
+    auto *class_type = llvm::cast<llvm::StructType>(object->getType()->getPointerElementType());
+    // the twine is only turned into a string if the values are named
+    return getField(object, node.field_index.value(),
+                    llvm::Twine(class_type->getName()) + "." + node.member.str());
 }
 
-llvm::Value *LLBuilder::getField(llvm::Value *object, const string &field) {
+llvm::Value *LLBuilder::getField(llvm::Value *object, unsigned field_index, const llvm::Twine &name) {
     auto *class_type = llvm::dyn_cast<llvm::StructType>(object->getType()->getPointerElementType());
     check(class_type);
-    int idx = -1;
-    const vector<string> &fields = class_fields.at(class_type);
-    for (size_t i = 0; i < fields.size() && idx == -1; i++)
-        if (field == fields[i])
-            idx = i;
-    check(idx != -1);
-
-    string inst_name = string(class_type->getName()) + "." + field;
-    // first index is 0 because we're already pointing to the object
-    return builder.CreateGEP(class_type, object, {builder.getInt32(0), builder.getInt32(idx)},
-                             inst_name);
+    check(field_index < class_type->getNumElements());
+    // gep with indices 0 (we're already pointing to the object) and field_index
+    return builder.CreateStructGEP(class_type, object, field_index, name);
 }
 
 llvm::Value *LLBuilder::convert(llvm::Value *val, llvm::Type *dest_ty) {
@@ -842,7 +1188,7 @@ llvm::Value *LLBuilder::convert(llvm::Value *val, llvm::Type *dest_ty) {
     if (val_ty == dest_ty)
         return val;
     // to bool conversions
-    else if (dest_ty == types.at("bool")) {
+    else if (dest_ty == getBuiltinType(cpm::SimpleType::Builtin::Bool)) {
         llvm::Value *zero = llvm::Constant::getNullValue(val_ty);
         llvm::Value *res = create_binary_op(val, zero, ast::NotEqual);
         res->setName("tobool");
@@ -868,10 +1214,22 @@ llvm::Value *LLBuilder::convert(llvm::Value *val, llvm::Type *dest_ty) {
     compiler_error("unimplemented case in 'convert'");
 }
 
-LLBuilder::LLBuilder() :
-        context(),
-        module("basic", context),
-        builder(context) {}
+LLBuilder::LLBuilder(const CodegenOptions &opts) :
+        owned_context(std::make_unique<llvm::LLVMContext>()),
+        owned_module(std::make_unique<llvm::Module>("basic", *owned_context)),
+        context(*owned_context),
+        module(*owned_module),
+        builder(context),
+        opts(opts) {
+    // the names of globals (functions, global variables) are always kept
+    context.setDiscardValueNames(opts.discard_value_names);
+}
+
+std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>>
+LLBuilder::releaseModule() {
+    check(owned_module != nullptr, "module has already been released");
+    return {std::move(owned_context), std::move(owned_module)};
+}
 
 bool LLBuilder::verifyModule() const {
     return llvm::verifyModule(module, &llvm::errs());
@@ -892,7 +1250,180 @@ void LLBuilder::run(const ast::TranslationUnit *start_tu) {
     if (already_run)
         compiler_error("rerunning LLBuilder is not allowed, please use a new instance");
     already_run = true;
-    codegen(*start_tu);
+    if (opts.threads > 1)
+        run_sharded(*start_tu);
+    else
+        codegen(*start_tu);
+    // finish global constructors function if it exists
+    if (global_ctors_func) {
+        builder.SetInsertPoint(&global_ctors_func->back());
+        builder.CreateRetVoid();
+        builder.ClearInsertionPoint();
+    }
+    order_globals();
+    internalize_functions();
+    delete_unused_declarations();
+    flush_statistics();
+}
+
+namespace {
+    /**
+     * Add the strings and intrinsics a value refers to, also through constant expressions,
+     * in the order of the operands.
+     */
+    void collect_referenced(llvm::Value *val, llvm::SetVector<llvm::GlobalVariable *> &strings,
+                            llvm::SetVector<llvm::Function *> &intrinsics,
+                            llvm::SmallPtrSetImpl<const llvm::Constant *> &visited) {
+        auto *c = llvm::dyn_cast<llvm::Constant>(val);
+        if (!c || !visited.insert(c).second)
+            return;
+        if (auto *var = llvm::dyn_cast<llvm::GlobalVariable>(c)) {
+            // only the strings are unnamed
+            if (!var->hasName())
+                strings.insert(var);
+            return;
+        }
+        if (auto *f = llvm::dyn_cast<llvm::Function>(c)) {
+            if (f->isIntrinsic())
+                intrinsics.insert(f);
+            return;
+        }
+        for (llvm::Value *op: c->operand_values())
+            collect_referenced(op, strings, intrinsics, visited);
+    }
+}
+
+void LLBuilder::order_globals() {
+    llvm::SetVector<llvm::GlobalVariable *> strings;
+    llvm::SetVector<llvm::Function *> intrinsics;
+    llvm::SmallPtrSet<const llvm::Constant *, 32> visited;
+    for (llvm::GlobalVariable &var: module.globals())
+        if (var.hasName() && var.hasInitializer())
+            collect_referenced(var.getInitializer(), strings, intrinsics, visited);
+    for (llvm::Function &f: module.functions())
+        for (llvm::Instruction &inst: llvm::instructions(f))
+            for (llvm::Value *op: inst.operand_values())
+                collect_referenced(op, strings, intrinsics, visited);
+
+    // a string left over from a global initializer that turned out not to be constant
+    vector<llvm::GlobalVariable *> unused;
+    for (llvm::GlobalVariable &var: module.globals())
+        if (!var.hasName() && !strings.count(&var))
+            unused.push_back(&var);
+    for (llvm::GlobalVariable *var: unused) {
+        var->removeDeadConstantUsers();
+        if (var->use_empty())
+            var->eraseFromParent();
+    }
+
+    for (llvm::GlobalVariable *var: strings) {
+        var->removeFromParent();
+        module.getGlobalList().push_back(var);
+    }
+    for (llvm::Function *f: intrinsics) {
+        f->removeFromParent();
+        module.getFunctionList().push_back(f);
+    }
+}
+
+void LLBuilder::internalize_functions() {
+    // the shards link by the names of the functions, so this is done after linking them
+    if (!opts.whole_program)
+        return;
+    llvm::Function *main_func = module.getFunction("main");
+    if (!main_func || main_func->isDeclaration())
+        return;
+    for (llvm::Function &f: module.functions()) {
+        if (&f == main_func || f.isDeclaration() || f.hasLocalLinkage())
+            continue;
+        f.setLinkage(llvm::GlobalValue::InternalLinkage);
+        ++num_internalized_functions;
+    }
+}
+
+void LLBuilder::run_sharded(const ast::TranslationUnit &tu) {
+    // bitcode of each shard, llvm can't link modules of different contexts directly
+    const unsigned threads = opts.threads;
+    vector<llvm::SmallVector<char, 0>> shard_bitcode(threads);
+    vector<std::exception_ptr> failures(threads);
+    vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; i++)
+        pool.emplace_back([&, i] {
+            try {
+                CodegenOptions shard_opts = opts;
+                shard_opts.threads = 1;
+                LLBuilder shard(shard_opts);
+                shard.part = Part::Declarations;
+                shard.codegen(tu);
+                size_t begin = i * shard.bodies.size() / threads;
+                size_t end = (i + 1) * shard.bodies.size() / threads;
+                if (begin == end)
+                    return;
+                for (size_t b = begin; b < end; b++)
+                    shard.define_function(*shard.bodies[b]);
+                shard.flush_statistics();
+                llvm::raw_svector_ostream os(shard_bitcode[i]);
+                llvm::WriteBitcodeToFile(shard.module, os);
+            }
+            catch (...) {
+                failures[i] = std::current_exception();
+            }
+        });
+    part = Part::Globals;
+    std::exception_ptr failure;
+    try {
+        codegen(tu);
+    }
+    catch (...) {
+        failure = std::current_exception();
+    }
+    for (std::thread &t: pool)
+        t.join();
+    if (failure)
+        std::rethrow_exception(failure);
+    for (const std::exception_ptr &f: failures)
+        if (f)
+            std::rethrow_exception(f);
+
+    // the linker maps the classes of a shard onto the ones of this module only if this module
+    // uses them, a class used only in the function bodies would get a copy per shard
+    vector<llvm::Type *> class_ptrs;
+    for (const auto &[name, type]: class_types)
+        class_ptrs.push_back(type->getPointerTo());
+    auto *class_anchor = new llvm::GlobalVariable(module, llvm::StructType::get(context, class_ptrs),
+                                                  false, llvm::GlobalValue::ExternalLinkage,
+                                                  nullptr, "class_anchor.cpp");
+
+    // the functions are declared in the order of the translation unit, linking moves
+    // the definitions to the end; a definition replaces the declaration of the same name
+    vector<string> order;
+    for (const llvm::Function &f: module.functions())
+        order.push_back(f.getName().str());
+    for (unsigned i = 0; i < threads; i++) {
+        if (shard_bitcode[i].empty())
+            continue;
+        llvm::StringRef bitcode(shard_bitcode[i].data(), shard_bitcode[i].size());
+        llvm::Expected<std::unique_ptr<llvm::Module>> shard_module =
+                llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, "shard"), context);
+        if (!shard_module)
+            compiler_error("cannot read shard module: " + llvm::toString(shard_module.takeError()));
+        if (llvm::Linker::linkModules(module, std::move(shard_module.get())))
+            compiler_error("cannot link shard module");
+        ++num_shards;
+    }
+    class_anchor->eraseFromParent();
+    // the intrinsics declared by the shards end up in front, order_globals moves them
+    for (const string &name: order) {
+        llvm::Function *f = module.getFunction(name);
+        f->removeFromParent();
+        module.getFunctionList().push_back(f);
+    }
+}
+
+void LLBuilder::flush_statistics() {
+    num_type_lowerings += type_lowerings;
+    num_type_cache_hits += type_cache_hits;
+    type_lowerings = type_cache_hits = 0;
 }
 
 llvm::Value *LLBuilder::operator()(const ast::DefaultArgExpr &node) {
@@ -923,7 +1454,10 @@ void LLBuilder::operator()(const ast::ForInitStmt &node) {
 }
 
 llvm::Value *LLBuilder::operator()(const ast::ArrToPtrExpr &node) {
-    llvm::Value *val = codegen(*node.arr_expr);
+    return array_to_pointer(codegen(*node.arr_expr));
+}
+
+llvm::Value *LLBuilder::array_to_pointer(llvm::Value *val) {
     llvm::Type *val_ty = val->getType();
     // array should be lvalue, thus in llvm we're holding a pointer to array
     check(val_ty->isPointerTy());
@@ -947,7 +1481,7 @@ llvm::Value *LLBuilder::operator()(const ast::SizeofTypeExpr &node) {
     // https://stackoverflow.com/questions/14608250/how-can-i-find-the-size-of-a-type
     llvm::Value *null = llvm::Constant::getNullValue(llvm::PointerType::get(type, 0));
     llvm::Value *null_plus_one = builder.CreateGEP(type, null, builder.getInt32(1));
-    llvm::Value *sizeof_val = builder.CreatePtrToInt(null_plus_one, types.at("int"), "sizeof");
+    llvm::Value *sizeof_val = builder.CreatePtrToInt(null_plus_one, getBuiltinType(cpm::SimpleType::Builtin::Int), "sizeof");
     return sizeof_val;
 }
 
@@ -961,10 +1495,19 @@ llvm::Value *LLBuilder::get_this_object() {
     compiler_error("invalid use of 'this'");
 }
 
-void LLBuilder::initialize_global_var(llvm::Value *ptr, const ast::Expr &ast_init_val) {
-    check(llvm::dyn_cast<llvm::GlobalVariable>(ptr));
+void LLBuilder::initialize_global_var(llvm::GlobalVariable *var, const ast::Expr &ast_init_val,
+                                      bool is_const) {
     check(!builder.GetInsertBlock() && "global initialization while in a function");
 
+    // e.g. 'int x = 5;' or 'const char *s = "abc";' need no code
+    if (llvm::Constant *init = evaluate_constant(ast_init_val)) {
+        check(init->getType() == var->getValueType());
+        var->setInitializer(init);
+        var->setConstant(is_const);
+        ++num_constant_globals;
+        return;
+    }
+
     if (!global_ctors_func) {
         create_global_ctors_func();
     }
@@ -972,12 +1515,198 @@ void LLBuilder::initialize_global_var(llvm::Value *ptr, const ast::Expr &ast_ini
     // generate the value and store it
     builder.SetInsertPoint(&global_ctors_func->getBasicBlockList().back());
     llvm::Value *init_val = codegen(ast_init_val);
-    builder.CreateStore(init_val, ptr);
+    builder.CreateStore(init_val, var);
+    ++num_dynamic_globals;
 
     // reset insert point
     builder.ClearInsertionPoint();
 }
 
+/**
+ * The values of int, char, bool and double expressions are computed by the semantic checker,
+ * which wraps them in ast::ConstantExpr, an arithmetic expression that isn't wrapped isn't
+ * constant. What's left here is what needs the layout of the module: addresses of globals
+ * and strings, offsets of fields and elements, and the size of classes.
+ *
+ * The constants are built by the IRBuilder of the LLBuilder, which folds instructions on
+ * constants into constants instead of inserting them. So the helpers of the code generation
+ * (create_binary_op, convert, ...) can be reused, as long as all their operands are constants.
+ */
+class LLBuilder::ConstantEvaluator {
+public:
+    explicit ConstantEvaluator(LLBuilder &codegen) :
+            codegen(codegen) {}
+
+    llvm::Constant *operator()(const ast::Expr &node) {
+        return std::visit(*this, node);
+    }
+
+    // everything else has side effects, reads memory, or would have been folded by
+    // the semantic checker if it was constant
+    template<typename T>
+    llvm::Constant *operator()(const T &) {
+        return nullptr;
+    }
+
+    llvm::Constant *operator()(const ast::IntLiteral &node) {
+        return llvm::cast<llvm::Constant>(codegen(node));
+    }
+
+    llvm::Constant *operator()(const ast::CharLiteral &node) {
+        return llvm::cast<llvm::Constant>(codegen(node));
+    }
+
+    llvm::Constant *operator()(const ast::BoolLiteral &node) {
+        return llvm::cast<llvm::Constant>(codegen(node));
+    }
+
+    llvm::Constant *operator()(const ast::FloatLiteral &node) {
+        return llvm::cast<llvm::Constant>(codegen(node));
+    }
+
+    llvm::Constant *operator()(const ast::NullptrLiteral &node) {
+        return llvm::cast<llvm::Constant>(codegen(node));
+    }
+
+    // the address of the string
+    llvm::Constant *operator()(const ast::StringLiteral &node) {
+        return llvm::cast<llvm::Constant>(codegen(node));
+    }
+
+    // folded by the semantic checker
+    llvm::Constant *operator()(const ast::ConstantExpr &node) {
+        return llvm::cast<llvm::Constant>(codegen(node));
+    }
+
+    // the semantic checker folds the size of the builtin types, not of classes
+    llvm::Constant *operator()(const ast::SizeofTypeExpr &node) {
+        return llvm::cast<llvm::Constant>(codegen(node));
+    }
+
+    // the address of a global variable
+    llvm::Constant *operator()(const ast::IdExpr &node) {
+        codegen.check(node.var.has_value());
+        auto it = codegen.vals.find(node.var.value());
+        if (it == codegen.vals.end())
+            return nullptr;
+        return llvm::dyn_cast<llvm::GlobalVariable>(it->second);
+    }
+
+    // an address stored in a const global, e.g. 'const char *const s = "abc";'
+    llvm::Constant *operator()(const ast::LValToRValExpr &node) {
+        auto *var = llvm::dyn_cast_or_null<llvm::GlobalVariable>(evaluate(*node.val));
+        if (!var || !var->isConstant() || !var->hasInitializer() ||
+            !var->getValueType()->isPointerTy())
+            return nullptr;
+        return var->getInitializer();
+    }
+
+    llvm::Constant *operator()(const ast::ImplicitTypeCastExpr &node) {
+        return convert(evaluate(*node.val), codegen.get_llvm_type(node.dest_ty));
+    }
+
+    llvm::Constant *operator()(const ast::CastExpr &node) {
+        return convert(evaluate(*node.expr), codegen.get_llvm_type(node.type));
+    }
+
+    llvm::Constant *operator()(const ast::ArrToPtrExpr &node) {
+        llvm::Constant *arr = evaluate(*node.arr_expr);
+        if (!arr)
+            return nullptr;
+        return folded(codegen.array_to_pointer(arr));
+    }
+
+    // the address of a global, already a pointer
+    llvm::Constant *operator()(const ast::UnaryExpr &node) {
+        if (node.op != ast::UnAnd)
+            return nullptr;
+        return evaluate(*node.expr);
+    }
+
+    // pointer arithmetic keeps the address relocatable, the other operations on addresses
+    // (comparisons, differences) can't be folded before the program is linked
+    llvm::Constant *operator()(const ast::BinaryExpr &node) {
+        if (node.op != ast::Plus && node.op != ast::Minus)
+            return nullptr;
+        llvm::Constant *lhs = evaluate(*node.lhs);
+        llvm::Constant *rhs = lhs && is_address(lhs) ? evaluate(*node.rhs) : nullptr;
+        if (!rhs || !is_value(rhs))
+            return nullptr;
+        return folded(codegen.create_binary_op(lhs, rhs, node.op));
+    }
+
+    // e.g. 'char *s = N > 1 ? "many" : "one";', the condition is folded
+    llvm::Constant *operator()(const ast::TernaryExpr &node) {
+        auto *cond = llvm::dyn_cast_or_null<llvm::ConstantInt>(evaluate(*node.cond));
+        if (!cond)
+            return nullptr;
+        return evaluate(cond->isOne() ? *node.then : *node.else_);
+    }
+
+    // the address of a field of a global object
+    llvm::Constant *operator()(const ast::MemberAccessExpr &node) {
+        llvm::Constant *object = evaluate(*node.object);
+        if (!object || !is_address(object))
+            return nullptr;
+        codegen.check(node.field_index.has_value());
+        return folded(codegen.getField(object, node.field_index.value()));
+    }
+
+    // the address of an element of a global array
+    llvm::Constant *operator()(const ast::SubscriptExpr &node) {
+        llvm::Constant *dest = evaluate(*node.dest);
+        llvm::Constant *index = dest ? evaluate(*node.index) : nullptr;
+        if (!dest || !index || !is_address(dest) || !is_value(index))
+            return nullptr;
+        return folded(codegen.create_binary_op(dest, index, ast::Plus));
+    }
+
+private:
+    LLBuilder &codegen;
+
+    llvm::Constant *evaluate(const ast::Expr &node) {
+        return (*this)(node);
+    }
+
+    /**
+     * Conversions to pointers, the arithmetic ones are folded by the semantic checker.
+     */
+    llvm::Constant *convert(llvm::Constant *val, llvm::Type *dest_ty) {
+        if (!val || !dest_ty->isPointerTy())
+            return nullptr;
+        return folded(codegen.convert(val, dest_ty));
+    }
+
+    /**
+     * Check that an operation has been folded.
+     */
+    llvm::Constant *folded(llvm::Value *val) {
+        auto *res = llvm::dyn_cast<llvm::Constant>(val);
+        codegen.check(res, "constant operation has not been folded");
+        if (llvm::isa<llvm::UndefValue>(res))
+            return nullptr;
+        return res;
+    }
+
+    /**
+     * Numbers, including sizeof, which is only folded once the data layout is known.
+     */
+    static bool is_value(const llvm::Constant *c) {
+        return !c->getType()->isPointerTy();
+    }
+
+    /**
+     * Address of a global (possibly with an offset), not nullptr.
+     */
+    static bool is_address(const llvm::Constant *c) {
+        return c->getType()->isPointerTy() && !c->isNullValue();
+    }
+};
+
+llvm::Constant *LLBuilder::evaluate_constant(const ast::Expr &node) {
+    return ConstantEvaluator(*this)(node);
+}
+
 void LLBuilder::create_global_ctors_func() {
     check(!global_ctors_func);
     global_ctors_func = llvm::Function::Create(
@@ -988,6 +1717,7 @@ void LLBuilder::create_global_ctors_func() {
             &module
     );
     global_ctors_func->setSection(".text.startup");
+    global_ctors_func->setDoesNotThrow();
     llvm::BasicBlock::Create(context, "entry", global_ctors_func);
 
     llvm::StructType *struct_type = llvm::StructType::get(context,
@@ -1027,15 +1757,25 @@ llvm::Value *LLBuilder::create_unary_minus(llvm::Value *val) {
 }
 
 llvm::Value *LLBuilder::create_load(llvm::Value *ptr) {
+    if (is_ssa_var(ptr))
+        return read_variable(llvm::cast<llvm::AllocaInst>(ptr), builder.GetInsertBlock());
     llvm::Type *load_type = ptr->getType()->getPointerElementType();
     check(load_type);
     return builder.CreateLoad(load_type, ptr);
 }
 
+void LLBuilder::create_store(llvm::Value *val, llvm::Value *ptr) {
+    if (is_ssa_var(ptr)) {
+        check(val->getType() == llvm::cast<llvm::AllocaInst>(ptr)->getAllocatedType());
+        write_variable(llvm::cast<llvm::AllocaInst>(ptr), builder.GetInsertBlock(), val);
+    } else
+        builder.CreateStore(val, ptr);
+}
+
 void LLBuilder::delete_unused_declarations() {
     vector<llvm::Function *> deleted_funcs;
     for (auto &f: module.functions())
-        if (f.empty() && !called_functions.contains(&f))
+        if (f.empty() && f.use_empty())
             deleted_funcs.push_back(&f);
     for (auto *f: deleted_funcs)
         f->eraseFromParent();
@@ -1050,7 +1790,7 @@ std::string LLBuilder::get_function_name(const ast::FunctionDecl *func_decl) {
             check(pt);
             cpm::SimpleType *st = cpm::simple_ty(pt->getElemType());
             check(st);
-            return st->getTypeId() + "::"s + func_name;
+            return st->getTypeId().str() + "::"s + func_name;
         }
     }
     return func_name;
@@ -3,8 +3,11 @@
 #include <variant>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <ostream>
 #include <stdexcept>
+#include <memory>
+#include <utility>
 
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
@@ -17,12 +20,37 @@
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/raw_os_ostream.h>
 #include <llvm/IR/CFG.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/ValueHandle.h>
 
 
 #include "ast/all_headers.h"
 #include "type/DerivedTypes.h"
+#include "utils/Symbol.h"
 
 namespace cpm {
+    /**
+     * Options of the llvm ir generation.
+     */
+    struct CodegenOptions {
+        // don't name the llvm values (instructions, arguments..), saves time and memory
+        // when the ir isn't read by humans
+        bool discard_value_names = false;
+        // number of threads that generate the function bodies, see LLBuilder::run
+        unsigned threads = 1;
+        // mark where local variables live by llvm.lifetime.start/end, so that the optimizer
+        // can reuse their stack slots; like in clang, it's only worth it when optimizing
+        bool lifetime_markers = false;
+        // keep the scalar local variables whose address is never taken in ssa registers
+        // instead of stack slots, see LLBuilder::create_local
+        bool ssa_locals = false;
+        // the translation unit is the whole program (besides the c library), so the functions
+        // other than main can be internalized, see LLBuilder::internalize_functions
+        bool whole_program = false;
+    };
+
 /**
  * This class generates the LLVM IR for given AST.
  *
@@ -32,11 +60,22 @@ namespace cpm {
 
     public:
 
-        explicit LLBuilder();
+        LLBuilder() :
+                LLBuilder(CodegenOptions()) {}
+
+        explicit LLBuilder(const CodegenOptions &opts);
 
         /**
          * Run the llvm ir generation.
          *
+         * With more than one thread, the function definitions are split into 'threads'
+         * shards of consecutive definitions. Each shard is generated into a module of its
+         * own, in its own llvm context, on a worker thread; the shard module declares
+         * everything from the rest of the translation unit. Meanwhile this builder generates
+         * the declarations and the global variables. The shards are then linked into
+         * this module in order, and the functions are put back into the order of their
+         * declarations. With order_globals, the module is the same for any number of threads.
+         *
          * UB if called more than once
          * @param ts
          */
@@ -53,6 +92,22 @@ namespace cpm {
          */
         bool verifyModule() const;
 
+        /**
+         * Get the built module, e.g. to run optimizations on it.
+         */
+        llvm::Module &getModule() {
+            return module;
+        }
+
+        /**
+         * Give up the ownership of the llvm context and the built module,
+         * e.g. to hand them over to the JIT.
+         *
+         * The builder must not be used afterwards.
+         */
+        std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>>
+        releaseModule();
+
         /* expressions */
         llvm::Value *operator()(const ast::Expr &node);
 
@@ -122,6 +177,8 @@ namespace cpm {
 
         llvm::Value *operator()(const ast::ArrToPtrExpr &node);
 
+        llvm::Value *operator()(const ast::ConstantExpr &node);
+
         llvm::Value *operator()(const ast::Condition &node);
 
         /* statements */
@@ -184,21 +241,36 @@ namespace cpm {
 
 
     private:
-        llvm::LLVMContext context;
-        llvm::Module module;
+        // context and module are owned through pointers so that they can be released,
+        // see releaseModule
+        std::unique_ptr<llvm::LLVMContext> owned_context;
+        std::unique_ptr<llvm::Module> owned_module;
+        llvm::LLVMContext &context;
+        llvm::Module &module;
         llvm::IRBuilder<> builder;
         // flag to avoid running a builder multiple times
         bool already_run = false;
+        CodegenOptions opts;
 
-        // map with <type name, llvm type>
-        std::map<std::string, llvm::Type *> types = {
-                {"int",       llvm::Type::getInt32Ty(context)},
-                {"char",      llvm::Type::getInt8Ty(context)},
-                {"bool",      llvm::Type::getInt1Ty(context)},
-                {"double",    llvm::Type::getDoubleTy(context)},
-                {"void",      llvm::Type::getVoidTy(context)},
-                {"nullptr_t", getPtrToVoid()}
+        /**
+         * What the builder generates when it visits the translation unit.
+         */
+        enum class Part {
+            // everything
+            All,
+            // declarations and global variables, the function definitions are only
+            // collected into 'bodies'
+            Globals,
+            // declarations, the global variables are declared as external,
+            // the function definitions are collected into 'bodies'
+            Declarations
         };
+        Part part = Part::All;
+        // function definitions in the order of the translation unit, unless part is All
+        std::vector<const ast::FuncDef *> bodies;
+
+        // llvm types of user defined classes, by class name
+        std::unordered_map<cpm::Symbol, llvm::StructType *, cpm::SymbolHash> class_types;
 
         /** For each value, index it by the declarator based on which it was created. */
         std::map<const ast::Decl *, llvm::Value *> vals;
@@ -220,6 +292,23 @@ namespace cpm {
         llvm::BasicBlock *return_bb = nullptr;
         // here the return value is stored before jumping to return_bb
         llvm::AllocaInst *ret_val = nullptr;
+        // the last alloca created by create_entry_alloca, nullptr if there's none yet
+        llvm::AllocaInst *last_alloca = nullptr;
+        // the local variables of each block scope we're in, from the outermost
+        std::vector<std::vector<llvm::AllocaInst *>> scope_slots;
+        // number of scopes in scope_slots at the start of each loop in break_bbs
+        std::vector<size_t> loop_scope_depths;
+        // the local variables kept in ssa registers, see create_local
+        llvm::DenseSet<const llvm::Value *> ssa_vars;
+        // the value of each ssa variable at the end of the blocks that define it (so far)
+        llvm::DenseMap<std::pair<const llvm::BasicBlock *, llvm::AllocaInst *>, llvm::WeakTrackingVH>
+                current_defs;
+        // phis of blocks that may still get predecessors, completed by seal_block
+        llvm::DenseMap<const llvm::BasicBlock *,
+                llvm::SmallVector<std::pair<llvm::AllocaInst *, llvm::PHINode *>, 4>>
+                incomplete_phis;
+        // blocks whose predecessors are all known
+        llvm::DenseSet<const llvm::BasicBlock *> sealed_blocks;
         // if we're inside a class method, this value is a pointer to
         // the 'this' pointer
         llvm::Value *this_lval = nullptr;
@@ -229,15 +318,31 @@ namespace cpm {
         // function that calls global constructors, is called before main
         llvm::Function *global_ctors_func = nullptr;
 
-        // keep a list of functions that have been called in the program
-        std::set<llvm::Function *> called_functions;
+        /**
+         * Generate the body of a function, see operator()(const ast::FuncDef &).
+         */
+        void define_function(const ast::FuncDef &node);
 
         /**
-         * For each class, save it's fields in the order they were declared.
+         * Generate the translation unit with the function bodies split into shards,
+         * see run().
+         */
+        void run_sharded(const ast::TranslationUnit &tu);
+
+        /**
+         * Move the strings and the intrinsic declarations after the other global variables
+         * and functions, in the order of their first use; strings that aren't used are deleted.
          *
-         * This does not save class methods, only fields (variables).
+         * They're created while the function bodies are generated, so they would be mixed in
+         * with the rest differently by each number of threads. The rest is already in the
+         * order of the translation unit.
+         */
+        void order_globals();
+
+        /**
+         * Add the counters of the type cache to the statistics.
          */
-        std::map<llvm::StructType *, std::vector<std::string>> class_fields;
+        void flush_statistics();
 
         /**
          * @return  the llvm function we're currently building in.
@@ -245,6 +350,104 @@ namespace cpm {
          */
         llvm::Function *getCurrentFunction();
 
+        /**
+         * Create an alloca in the entry block of the current function, after the other allocas.
+         *
+         * Stack slots in other blocks would be allocated each time the block runs
+         * (e.g. in a loop), and mem2reg and SROA only promote the ones in the entry block.
+         */
+        llvm::AllocaInst *create_entry_alloca(llvm::Type *type, const llvm::Twine &name = "");
+
+        /**
+         * Create the storage of a local variable or a parameter.
+         *
+         * With CodegenOptions::ssa_locals, a scalar variable whose address is never taken
+         * doesn't get a stack slot, its value is kept in ssa registers. It's built on the fly
+         * as in "Simple and Efficient Construction of Static Single Assignment Form" (Braun
+         * et al.): every store defines a new value of the variable in the current block,
+         * a load looks the value up through the predecessors and creates phis where they
+         * meet. The variable is represented by a placeholder alloca that is never inserted
+         * into the function, so that it can stand for the lvalue like a stack slot, as long
+         * as it's only accessed by create_load and create_store.
+         *
+         * @param decl  declaration of the variable, nullptr for compiler temporaries
+         */
+        llvm::AllocaInst *create_local(llvm::Type *type, const ast::Decl *decl,
+                                       const llvm::Twine &name = "");
+
+        /**
+         * Check whether a value is a placeholder of a variable kept in ssa registers.
+         */
+        bool is_ssa_var(const llvm::Value *val) const {
+            return ssa_vars.contains(val);
+        }
+
+        /**
+         * Set the value of an ssa variable at the end of a block.
+         */
+        void write_variable(llvm::AllocaInst *var, const llvm::BasicBlock *bb, llvm::Value *val);
+
+        /**
+         * Get the value of an ssa variable at the end of a block.
+         */
+        llvm::Value *read_variable(llvm::AllocaInst *var, llvm::BasicBlock *bb);
+
+        /**
+         * Get the value of an ssa variable that isn't defined in the block itself.
+         */
+        llvm::Value *read_variable_recursive(llvm::AllocaInst *var, llvm::BasicBlock *bb);
+
+        /**
+         * Create an empty phi at the start of a block.
+         */
+        llvm::PHINode *create_phi(llvm::Type *type, llvm::BasicBlock *bb, const llvm::Twine &name);
+
+        /**
+         * Add an incoming value from each predecessor to a phi of an ssa variable.
+         * @return  the phi, or the value that replaced it if it's trivial
+         */
+        llvm::Value *add_phi_operands(llvm::AllocaInst *var, llvm::PHINode *phi);
+
+        /**
+         * Replace a phi that merges just one value (and itself) by the value.
+         * @return  the phi, or the value that replaced it
+         */
+        llvm::Value *try_remove_trivial_phi(llvm::PHINode *phi);
+
+        /**
+         * Declare that all predecessors of a block have been generated, completes the
+         * phis created while they weren't known. No-op without CodegenOptions::ssa_locals.
+         */
+        void seal_block(llvm::BasicBlock *bb);
+
+        /**
+         * Drop the ssa state of the function that has just been generated.
+         */
+        void finish_ssa();
+
+        /**
+         * Open a block scope for local variables.
+         */
+        void push_scope();
+
+        /**
+         * Close the innermost block scope, ends the lifetime of its variables if the current
+         * block continues.
+         */
+        void pop_scope();
+
+        /**
+         * Start the lifetime of a local variable at the current insert point, see
+         * CodegenOptions::lifetime_markers. The lifetime ends with the innermost scope.
+         */
+        void start_lifetime(llvm::AllocaInst *slot);
+
+        /**
+         * End the lifetime of the variables of the scopes from 'depth' up, before a jump
+         * out of them (break, continue, return).
+         */
+        void end_lifetimes(size_t depth);
+
         /**
          * Creates and returns a new BasicBlock which is put at the
          * end of current function.
@@ -271,6 +474,11 @@ namespace cpm {
             return builder.getInt8PtrTy();
         }
 
+        /**
+         * Get the llvm type of a builtin type, e.g. i32 for int.
+         */
+        llvm::Type *getBuiltinType(cpm::SimpleType::Builtin builtin);
+
         /**
          * Create a shortcircuit for '&&' or '||'.
          * @param node
@@ -278,14 +486,32 @@ namespace cpm {
          */
         llvm::Value *create_shortcircuit(const ast::BinaryExpr &node);
 
+        /**
+         * @return the condition if its value is known at compile time, nullptr otherwise
+         */
+        static const ast::ConstantExpr *constant_condition(const ast::Condition &cond);
+
         /**
          * For given cpm::Type, return corresponding llvm::Type.
          *
+         * The result is cached, so only the first call for a type does any work.
+         * Class types must be created before their first use.
          * @param type
          * @return
          */
         llvm::Type *get_llvm_type(cpm::Type *type);
 
+        /**
+         * Uncached part of get_llvm_type.
+         */
+        llvm::Type *lower_type(cpm::Type *type);
+
+        // cache of get_llvm_type
+        llvm::DenseMap<const cpm::Type *, llvm::Type *> llvm_types;
+        // counters of get_llvm_type, added to the statistics at the end of run()
+        size_t type_lowerings = 0;
+        size_t type_cache_hits = 0;
+
         /**
          * Creates instruction to convert value to dest type.
          */
@@ -299,13 +525,19 @@ namespace cpm {
         /**
          * Access a class field.
          *
-         * This method is separated because this is needed both in MemberAccessExpr and
-         * in IdExpr.
-         * @param objectPtr
-         * @param field
-         * @return
+         * @param objectPtr  pointer to the class object
+         * @param field_index  index of the field, resolved by the semantic checker
+         * @param name  name of the created value
+         * @return pointer to the field
          */
-        llvm::Value *getField(llvm::Value *objectPtr, const std::string &field);
+        llvm::Value *getField(llvm::Value *objectPtr, unsigned field_index,
+                              const llvm::Twine &name = "");
+
+        /**
+         * Get the pointer to the first element of an array.
+         * @param arr  the array lvalue, i.e. pointer to the array
+         */
+        llvm::Value *array_to_pointer(llvm::Value *arr);
 
         /**
          * Creates the increment or decrement (by one) operation on a value.
@@ -354,23 +586,60 @@ namespace cpm {
 
         /**
          * Initialize global variable with given value.
-         * @param ptr
+         *
+         * A constant initializer (see evaluate_constant) becomes the initializer of the global,
+         * which is then also marked constant if its type is const. The other initializers
+         * are run before main, by the function in llvm.global_ctors.
+         * @param var
          * @param ast_init_val
+         * @param is_const  whether the type of the variable is const
          */
-        void initialize_global_var(llvm::Value *ptr, const ast::Expr &ast_init_val);
+        void initialize_global_var(llvm::GlobalVariable *var, const ast::Expr &ast_init_val,
+                                   bool is_const);
+
+        /**
+         * Visitor that evaluates expressions at compile time, see evaluate_constant.
+         */
+        class ConstantEvaluator;
+
+        /**
+         * Evaluate an expression at compile time, without a function to generate code into.
+         *
+         * Handles literals and the values folded by the semantic checker (ast::ConstantExpr),
+         * the size of classes, addresses of strings and global variables (also with offsets),
+         * and addresses stored in const globals. The result can always be emitted as a static
+         * initializer, e.g. the difference of two addresses is left to run time.
+         * @return  the constant, nullptr if the expression has to be evaluated at run time
+         */
+        llvm::Constant *evaluate_constant(const ast::Expr &node);
 
         void create_global_ctors_func();
 
         /**
-         * Create a load from a value.
+         * Create a load from a value, or read the value of an ssa variable.
          *
          * Expects the pointer to be typed, won't work with opaque pointers.
          */
         llvm::Value *create_load(llvm::Value *ptr);
 
+        /**
+         * Create a store to a value, or define a new value of an ssa variable.
+         */
+        void create_store(llvm::Value *val, llvm::Value *ptr);
+
+        /**
+         * Give the defined functions other than main internal linkage, if the translation
+         * unit is the whole program (CodegenOptions::whole_program). The optimizer can then
+         * inline and drop the functions freely. Defining main isn't enough, the other
+         * translation units of a program may call the functions.
+         */
+        void internalize_functions();
+
         /**
          * Delete functions that have been declared but not defined, and
          * that have not been used in the program. e.g. useless declarations
+         *
+         * C+- can't take the address of a function, so every use is a call.
          */
         void delete_unused_declarations();
 
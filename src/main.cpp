@@ -1,44 +1,60 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cstdlib>
 #include <optional>
+#include <filesystem>
+#include <thread>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
-#include "parser/Parser.h"
-#include "semantic_checker/SemanticChecker.h"
-#include "ll_builder/LLBuilder.h"
-#include "ast_dumper/AstDumper.h"
-
-enum class ReturnValue : int32_t {
-    Success = EXIT_SUCCESS,
-    Failure = EXIT_FAILURE,
-    FileNotFound = 2,
-    FileOpen = 2,
-    AntlrSyntaxError = 3,
-    AntlrVisitError = 4,
-    ScVisitError = 5,
-};
-
-int exitCode(ReturnValue ret) {
-    return static_cast<std::underlying_type_t<ReturnValue>>(ret);
-}
+#include "driver/Driver.h"
+#include "server/CompileServer.h"
+#include "utils/Statistic.h"
 
 using namespace std;
-using namespace ast;
+using namespace cpm::driver;
 
 namespace po = boost::program_options;
 
-std::ostream &file_or_cout(optional<ofstream> &output_file) {
-    if (!output_file) {
-        return std::cout;
+/**
+ * Let the compile server compile the file, and write out what it returned
+ * as if the file was compiled by this process.
+ * @return the exit code, or std::nullopt if the server couldn't be reached or didn't take
+ *         the file, which is then compiled locally
+ */
+optional<int> compile_remote(const string &socket_path, const string &input_path,
+                             const optional<string> &output_path, const CompileOptions &opts) {
+    ifstream file(input_path, ios::binary);
+    if (!file)
+        // let the local compilation report the error
+        return nullopt;
+    ostringstream source;
+    source << file.rdbuf();
+
+    optional<cpm::server::Response> res =
+            cpm::server::request_compile(socket_path, {opts, source.str()});
+    if (!res)
+        return nullopt;
+
+    cout << res->log;
+    cerr << res->err;
+    if (res->exit_code == exitCode(ReturnValue::Success) || !res->out.empty()) {
+        if (output_path) {
+            ofstream output_file(*output_path, ios::binary);
+            if (!output_file) {
+                cerr << "couldn't open file: " << *output_path << endl;
+                return exitCode(ReturnValue::FileOpen);
+            }
+            output_file << res->out;
+        } else
+            cout << res->out;
     }
-
-    return *output_file;
+    return res->exit_code;
 }
 
 int main(int argc, char **argv) {
-    optional<ofstream> output_file;
-
     po::options_description generic("Allowed options");
     generic.add_options()
             ("help,h", "produce help message")
@@ -46,7 +62,36 @@ int main(int argc, char **argv) {
             ("ast-dump-raw", "dump AST before semantic analysis")
             ("ast-dump", "dump AST after semantic analysis")
             ("ir", "output llvm ir (default)")
-            ("input-file", "input file (option can be omitted)");
+            ("emit", po::value<string>(), "output format: ll (default), bc, asm or obj")
+            ("compile,c", "output a native object file, same as --emit=obj")
+            ("run", "jit-compile the program and run it, exit with the value returned from main")
+            ("optimize,O", po::value<unsigned>()->default_value(0),
+             "optimization level, -O0 to -O3")
+            ("time", "report time spent in the optimization pipeline")
+            ("stats", "report statistics of the compilation, e.g. which parsing "
+                      "strategy succeeded")
+            ("discard-value-names", "don't name values in the llvm ir, only functions and globals")
+            ("max-errors", po::value<unsigned>()->default_value(20),
+             "stop semantic analysis after this many errors, 0 for no limit")
+            ("sema-threads", po::value<unsigned>()->default_value(1),
+             "number of threads that check function bodies in semantic analysis, "
+             "0 for number of cores")
+            ("codegen-threads", po::value<unsigned>()->default_value(1),
+             "number of threads that generate llvm ir of function bodies, 0 for number of cores")
+            ("ssa-locals", "keep local variables whose address isn't taken in ssa registers "
+                           "instead of stack slots, makes smaller ir and a faster optimizer")
+            ("whole-program", "the file is the whole program, its functions other than main "
+                              "aren't called from other files and can be optimized away")
+            ("daemon", po::value<string>(),
+             "run as a compile server listening on given unix socket")
+            ("server", po::value<string>(),
+             "let the compile server on given unix socket do the compilation, "
+             "can also be set by the CPM_SERVER environment variable")
+            ("jobs,j", po::value<unsigned>()->default_value(1),
+             "number of files compiled in parallel, 0 for number of cores")
+            ("input-file", po::value<vector<string>>(),
+             "input files (option can be omitted); with multiple files, each one is "
+             "compiled into a file next to it, e.g. 'src/a.cpp' into 'src/a.ll'");
 
     po::positional_options_description p;
     p.add("input-file", -1);
@@ -63,73 +108,97 @@ int main(int argc, char **argv) {
         return exitCode(ReturnValue::Success);
     }
 
+    if (vm.count("daemon")) {
+        try {
+            cpm::server::CompileServer server(vm["daemon"].as<string>());
+            server.serve();
+        }
+        catch (const std::exception &e) {
+            cerr << "error: " << e.what() << endl;
+        }
+        return exitCode(ReturnValue::Failure);
+    }
+
     if (!vm.count("input-file")) {
         cout << "missing input file" << endl;
         return exitCode(ReturnValue::FileNotFound);
     }
+    const auto &input_paths = vm["input-file"].as<vector<string>>();
 
-    ifstream file(vm["input-file"].as<string>());
-    if (!file) {
-        cout << "couldn't open file: " << vm["input-file"].as<string>() << endl;
-        return exitCode(ReturnValue::FileOpen);
-    }
-
-    cpm::Context context(file);
-    file.close();
-
-    Parser parser(context);
-    cpm::sc::SemanticChecker semantic_checker(context, std::cout);
-    AstDumper ast_dumper;
-    cpm::LLBuilder ll_builder;
-    ast::node_ptr<ast::TranslationUnit> ast;
-
+    CompileOptions opts;
     try {
-        ast = parser.parse();
+        opts.opt_level = cpm::Optimizer::parseLevel(vm["optimize"].as<unsigned>());
+        if (vm.count("compile"))
+            opts.emit_kind = cpm::EmitKind::Object;
+        if (vm.count("emit"))
+            opts.emit_kind = cpm::Emitter::parseKind(vm["emit"].as<string>());
     }
-    catch (const Parser::SyntaxError &e) {
-        std::cerr << "error: " << e.what() << std::endl;
-        return exitCode(ReturnValue::AntlrSyntaxError);
+    catch (const std::exception &e) {
+        std::cerr << "error: " << e.what() << endl;
+        return exitCode(ReturnValue::Failure);
     }
-    catch (const Parser::VisitError &e) {
-        std::cerr << "error: " << e.what() << std::endl;
-        return exitCode(ReturnValue::AntlrVisitError);
+    opts.ast_dump_raw = vm.count("ast-dump-raw");
+    opts.ast_dump = vm.count("ast-dump");
+    opts.run = vm.count("run");
+    opts.time = vm.count("time");
+    opts.stats = vm.count("stats");
+    opts.discard_value_names = vm.count("discard-value-names");
+    opts.ssa_locals = vm.count("ssa-locals");
+    opts.whole_program = vm.count("whole-program");
+    opts.max_errors = vm["max-errors"].as<unsigned>();
+    opts.sema_threads = vm["sema-threads"].as<unsigned>();
+    if (opts.sema_threads == 0)
+        opts.sema_threads = std::max(1u, thread::hardware_concurrency());
+    opts.codegen_threads = vm["codegen-threads"].as<unsigned>();
+    if (opts.codegen_threads == 0)
+        opts.codegen_threads = std::max(1u, thread::hardware_concurrency());
+
+    //------------- single file --------------------------
+    if (input_paths.size() == 1) {
+        const string &input_path = input_paths.front();
+        optional<string> output_path;
+        if (vm.count("output"))
+            output_path = vm["output"].as<string>();
+        // like other compilers, '-c' without '-o' writes 'input.o' instead of stdout
+        else if (opts.emit_kind == cpm::EmitKind::Object)
+            output_path = filesystem::path(input_path).stem().string() + ".o";
+
+        // the program has to run in this process, so --run is never sent to the server;
+        // neither is --stats, the statistics are counted by the process that compiles
+        optional<string> server_path;
+        if (vm.count("server"))
+            server_path = vm["server"].as<string>();
+        else if (const char *env = std::getenv("CPM_SERVER"))
+            server_path = env;
+        if (server_path && !opts.run && !opts.stats)
+            if (optional<int> ret = compile_remote(*server_path, input_path, output_path, opts))
+                return *ret;
+
+        int ret = compile_file(input_path, output_path, opts, {cout, cout, cerr});
+        if (opts.stats)
+            cpm::Statistic::print_all(cerr);
+        return ret;
     }
 
+    //------------- multiple files -----------------------
     if (vm.count("output")) {
-        output_file = ofstream(vm["output"].as<string>());
-        if (!*output_file) {
-            std::cerr << "couldn't open file: " << vm["output"].as<string>() << endl;
-            return exitCode(ReturnValue::FileOpen);
-        }
-    }
-
-    //--------- dump raw ast is the user chooses ------------
-    if (vm.count("ast-dump-raw")) {
-        ast_dumper.run(*ast, file_or_cout(output_file));
-        return exitCode(ReturnValue::Success);
-    }
-
-    //--------------- perform semantic analysis ----------------
-    try {
-        semantic_checker.run(*ast);
-    }
-    catch (const std::exception &e) {
-        std::cerr << e.what() << endl;
-        return exitCode(ReturnValue::ScVisitError);
+        cerr << "error: cannot use --output with multiple input files" << endl;
+        return exitCode(ReturnValue::Failure);
     }
-
-    //------------- dump ast if the user chooses -------------
-    if (vm.contains("ast-dump")) {
-        ast_dumper.run(*ast, file_or_cout(output_file));
-        return exitCode(ReturnValue::Success);
+    if (opts.run) {
+        cerr << "error: cannot use --run with multiple input files" << endl;
+        return exitCode(ReturnValue::Failure);
     }
-
-    //------------- generate llvm ir ----------------------
-    ll_builder.run(ast.get());
-    ll_builder.dumpModule(file_or_cout(output_file));
-    if (ll_builder.verifyModule()) {
-        cout << "LLVM module verification failed" << endl;
+    if (opts.whole_program) {
+        cerr << "error: cannot use --whole-program with multiple input files" << endl;
         return exitCode(ReturnValue::Failure);
     }
-    return exitCode(ReturnValue::Success);
+
+    unsigned jobs = vm["jobs"].as<unsigned>();
+    if (jobs == 0)
+        jobs = std::max(1u, thread::hardware_concurrency());
+    int ret = compile_batch(input_paths, opts, jobs);
+    if (opts.stats)
+        cpm::Statistic::print_all(cerr);
+    return ret;
 }
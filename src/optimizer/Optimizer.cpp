@@ -0,0 +1,66 @@
+#include "Optimizer.h"
+
+#include <stdexcept>
+
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/OptimizationLevel.h>
+
+using namespace std;
+
+namespace cpm {
+    Optimizer::Optimizer(OptLevel level, llvm::TargetMachine *target_machine) :
+            level(level),
+            target_machine(target_machine) {}
+
+    void Optimizer::run(llvm::Module &module) {
+        // analysis managers must be declared in this order so that they are
+        // destroyed in the right order, see llvm docs 'Using the New Pass Manager'
+        llvm::LoopAnalysisManager lam;
+        llvm::FunctionAnalysisManager fam;
+        llvm::CGSCCAnalysisManager cgam;
+        llvm::ModuleAnalysisManager mam;
+
+        llvm::PassBuilder pb(target_machine);
+        pb.registerModuleAnalyses(mam);
+        pb.registerCGSCCAnalyses(cgam);
+        pb.registerFunctionAnalyses(fam);
+        pb.registerLoopAnalyses(lam);
+        pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+        llvm::ModulePassManager mpm;
+        switch (level) {
+            case OptLevel::O0:
+                mpm = pb.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+                break;
+            case OptLevel::O1:
+                mpm = pb.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O1);
+                break;
+            case OptLevel::O2:
+                mpm = pb.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+                break;
+            case OptLevel::O3:
+                mpm = pb.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3);
+                break;
+        }
+        mpm.run(module, mam);
+    }
+
+    OptLevel Optimizer::parseLevel(unsigned level) {
+        switch (level) {
+            case 0:
+                return OptLevel::O0;
+            case 1:
+                return OptLevel::O1;
+            case 2:
+                return OptLevel::O2;
+            case 3:
+                return OptLevel::O3;
+            default:
+                throw std::invalid_argument("unknown optimization level -O" + std::to_string(level));
+        }
+    }
+
+    std::string Optimizer::to_string(OptLevel level) {
+        return "-O" + std::to_string(static_cast<int>(level));
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace cpm {
+    /**
+     * Optimization levels accepted by the driver (-O0 to -O3).
+     */
+    enum class OptLevel {
+        O0,
+        O1,
+        O2,
+        O3
+    };
+
+    /**
+     * Runs the LLVM (new pass manager) optimization pipeline over a module.
+     *
+     * The pipeline is the default per-module pipeline of the given level,
+     * it contains mem2reg (SROA), instcombine, GVN, loop passes and inlining.
+     */
+    class Optimizer {
+    public:
+        /**
+         * @param target_machine  if set, the optimizer uses target specific
+         *                        information (cost model, data layout)
+         */
+        explicit Optimizer(OptLevel level, llvm::TargetMachine *target_machine = nullptr);
+
+        /**
+         * Optimize the module in place.
+         *
+         * The module is expected to pass the llvm verifier.
+         */
+        void run(llvm::Module &module);
+
+        OptLevel getLevel() const {
+            return level;
+        }
+
+        /**
+         * Parse the optimization level from its numeric value, e.g. 2 for -O2.
+         *
+         * Throws std::invalid_argument for unknown levels.
+         */
+        static OptLevel parseLevel(unsigned level);
+
+        static std::string to_string(OptLevel level);
+
+    private:
+        OptLevel level;
+        llvm::TargetMachine *target_machine;
+    };
+}
@@ -0,0 +1,59 @@
+#include "BufferCharStream.h"
+
+BufferCharStream::BufferCharStream(std::string_view buffer, std::string source_name) :
+        buffer(buffer),
+        source_name(std::move(source_name)) {}
+
+void BufferCharStream::consume() {
+    if (p >= buffer.size())
+        throw antlr4::IllegalStateException("cannot consume EOF");
+    p++;
+}
+
+size_t BufferCharStream::LA(ssize_t i) {
+    if (i == 0)
+        return 0; // undefined
+    // LA(-1) is the previous character
+    ssize_t pos = i < 0 ? static_cast<ssize_t>(p) + i : static_cast<ssize_t>(p) + i - 1;
+    if (pos < 0 || static_cast<size_t>(pos) >= buffer.size())
+        return antlr4::IntStream::EOF;
+    return static_cast<unsigned char>(buffer[pos]);
+}
+
+ssize_t BufferCharStream::mark() {
+    // the whole buffer is always available, there's nothing to mark
+    return -1;
+}
+
+void BufferCharStream::release(ssize_t) {}
+
+size_t BufferCharStream::index() {
+    return p;
+}
+
+void BufferCharStream::seek(size_t index) {
+    p = std::min(index, buffer.size());
+}
+
+size_t BufferCharStream::size() {
+    return buffer.size();
+}
+
+std::string BufferCharStream::getSourceName() const {
+    return source_name.empty() ? antlr4::IntStream::UNKNOWN_SOURCE_NAME : source_name;
+}
+
+std::string BufferCharStream::getText(const antlr4::misc::Interval &interval) {
+    if (interval.a < 0 || interval.b < interval.a)
+        return "";
+    auto start = static_cast<size_t>(interval.a);
+    auto stop = static_cast<size_t>(interval.b);
+    if (start >= buffer.size())
+        return "";
+    stop = std::min(stop, buffer.size() - 1);
+    return std::string(buffer.substr(start, stop - start + 1));
+}
+
+std::string BufferCharStream::toString() const {
+    return std::string(buffer);
+}
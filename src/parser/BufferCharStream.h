@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "antlr4-runtime.h"
+
+/**
+ * antlr4 character stream that reads directly from a buffer, without copying it.
+ *
+ * Unlike antlr4::ANTLRInputStream, which decodes the whole input into UTF-32,
+ * this stream yields the bytes of the buffer as they are. C+- tokens are ASCII, and
+ * UTF-8 bytes in string literals and comments are matched byte by byte, so lexing
+ * is not affected. Character positions (columns) are counted in bytes.
+ *
+ * The buffer must outlive the stream.
+ */
+class BufferCharStream : public antlr4::CharStream {
+public:
+    explicit BufferCharStream(std::string_view buffer, std::string source_name = "");
+
+    void consume() override;
+
+    size_t LA(ssize_t i) override;
+
+    ssize_t mark() override;
+
+    void release(ssize_t marker) override;
+
+    size_t index() override;
+
+    void seek(size_t index) override;
+
+    size_t size() override;
+
+    std::string getSourceName() const override;
+
+    std::string getText(const antlr4::misc::Interval &interval) override;
+
+    std::string toString() const override;
+
+    /**
+     * The whole underlying buffer.
+     */
+    std::string_view getBuffer() const {
+        return buffer;
+    }
+
+private:
+    std::string_view buffer;
+    std::string source_name;
+    // index of the next character
+    size_t p = 0;
+};
@@ -0,0 +1,512 @@
+#include "BufferLexer.h"
+
+#include <cstring>
+
+#include "CPMLexer.h"
+
+namespace {
+    // token type for whitespace and comments, which are skipped
+    constexpr size_t Skip = antlr4::Token::INVALID_TYPE;
+
+    bool is_digit(int c) {
+        return c >= '0' && c <= '9';
+    }
+
+    bool is_octal_digit(int c) {
+        return c >= '0' && c <= '7';
+    }
+
+    bool is_binary_digit(int c) {
+        return c == '0' || c == '1';
+    }
+
+    bool is_hex_digit(int c) {
+        return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    bool is_identifier_start(int c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    bool is_identifier_char(int c) {
+        return is_identifier_start(c) || is_digit(c);
+    }
+
+    /**
+     * @return token type of the keyword, or CPMLexer::Identifier if it's not a keyword
+     */
+    size_t keyword_type(std::string_view id) {
+        // 'true', 'false' and 'nullptr' are literals, their rules come before
+        // the keyword rules in the grammar
+        switch (id[0]) {
+            case 'a':
+                if (id == "and") return CPMLexer::AndAnd;
+                break;
+            case 'b':
+                if (id == "bool") return CPMLexer::Bool;
+                if (id == "break") return CPMLexer::Break;
+                break;
+            case 'c':
+                if (id == "char") return CPMLexer::Char;
+                if (id == "class") return CPMLexer::Class;
+                if (id == "const") return CPMLexer::Const;
+                if (id == "continue") return CPMLexer::Continue;
+                break;
+            case 'd':
+                if (id == "do") return CPMLexer::Do;
+                if (id == "double") return CPMLexer::Double;
+                break;
+            case 'e':
+                if (id == "else") return CPMLexer::Else;
+                break;
+            case 'f':
+                if (id == "false") return CPMLexer::BooleanLiteral;
+                if (id == "for") return CPMLexer::For;
+                break;
+            case 'i':
+                if (id == "if") return CPMLexer::If;
+                if (id == "int") return CPMLexer::Int;
+                break;
+            case 'n':
+                if (id == "nullptr") return CPMLexer::PointerLiteral;
+                if (id == "not") return CPMLexer::Not;
+                break;
+            case 'o':
+                if (id == "or") return CPMLexer::OrOr;
+                break;
+            case 'p':
+                if (id == "private") return CPMLexer::Private;
+                if (id == "public") return CPMLexer::Public;
+                break;
+            case 'r':
+                if (id == "return") return CPMLexer::Return;
+                break;
+            case 's':
+                if (id == "sizeof") return CPMLexer::Sizeof;
+                if (id == "struct") return CPMLexer::Struct;
+                break;
+            case 't':
+                if (id == "this") return CPMLexer::This;
+                if (id == "true") return CPMLexer::BooleanLiteral;
+                break;
+            case 'v':
+                if (id == "void") return CPMLexer::Void;
+                break;
+            case 'w':
+                if (id == "while") return CPMLexer::While;
+                break;
+            default:
+                break;
+        }
+        return CPMLexer::Identifier;
+    }
+
+    /**
+     * Same as antlr4::Lexer::getErrorDisplay.
+     */
+    std::string error_display(std::string_view text) {
+        std::string res;
+        for (char c: text) {
+            switch (c) {
+                case '\n':
+                    res += "\\n";
+                    break;
+                case '\t':
+                    res += "\\t";
+                    break;
+                case '\r':
+                    res += "\\r";
+                    break;
+                default:
+                    res += c;
+            }
+        }
+        return res;
+    }
+}
+
+BufferToken::BufferToken(BufferLexer *source, size_t type, size_t start, size_t stop, size_t line,
+                         size_t char_position_in_line) :
+        source(source),
+        start(start),
+        stop(stop),
+        type(type),
+        line(line),
+        char_position_in_line(char_position_in_line) {}
+
+std::string BufferToken::getText() const {
+    if (custom_text)
+        return *custom_text;
+    if (type == antlr4::Token::EOF)
+        return "<EOF>";
+    return std::string(getTextView());
+}
+
+std::string_view BufferToken::getTextView() const {
+    if (custom_text)
+        return *custom_text;
+    if (type == antlr4::Token::EOF || start > stop)
+        return "";
+    return source->getBuffer().substr(start, stop - start + 1);
+}
+
+antlr4::TokenSource *BufferToken::getTokenSource() const {
+    return source;
+}
+
+antlr4::CharStream *BufferToken::getInputStream() const {
+    return source->getInputStream();
+}
+
+void BufferToken::setText(const std::string &text) {
+    custom_text = std::make_unique<std::string>(text);
+}
+
+std::string BufferToken::toString() const {
+    std::string channel_str = channel > 0 ? ",channel=" + std::to_string(channel) : "";
+    std::string text = getText();
+    std::string escaped;
+    for (char c: text) {
+        if (c == '\n')
+            escaped += "\\n";
+        else if (c == '\r')
+            escaped += "\\r";
+        else if (c == '\t')
+            escaped += "\\t";
+        else
+            escaped += c;
+    }
+    return "[@" + std::to_string(static_cast<ssize_t>(token_index)) + "," + std::to_string(start) + ":" +
+           std::to_string(static_cast<ssize_t>(stop)) + "='" + escaped + "',<" + std::to_string(type) + ">" +
+           channel_str + "," + std::to_string(line) + ":" + std::to_string(char_position_in_line) + "]";
+}
+
+BufferLexer::BufferLexer(BufferCharStream &input, antlr4::ANTLRErrorListener *error_listener) :
+        input(input),
+        buffer(input.getBuffer()),
+        error_listener(error_listener) {}
+
+antlr4::TokenFactory<antlr4::CommonToken> *BufferLexer::getTokenFactory() {
+    // only used by the parser to conjure up missing tokens during error recovery
+    return antlr4::CommonTokenFactory::DEFAULT.get();
+}
+
+std::unique_ptr<antlr4::Token> BufferLexer::nextToken() {
+    while (pos < buffer.size()) {
+        Match match = match_token();
+        if (!match.ok) {
+            report_error(match.end);
+            // like antlr, continue after the offending character
+            advance_to(std::min(match.end + 1, buffer.size()));
+            continue;
+        }
+        if (match.type == Skip) {
+            advance_to(match.end);
+            continue;
+        }
+        auto token = std::make_unique<BufferToken>(this, match.type, pos, match.end - 1, line,
+                                                   pos - line_start);
+        advance_to(match.end);
+        return token;
+    }
+    // the stop index of EOF is one before the start, just like in antlr
+    return std::make_unique<BufferToken>(this, antlr4::Token::EOF, pos, pos - 1, line, pos - line_start);
+}
+
+void BufferLexer::advance_to(size_t end) {
+    // only '\n' starts a new line, same as in antlr
+    const char *data = buffer.data();
+    while (pos < end) {
+        auto *nl = static_cast<const char *>(std::memchr(data + pos, '\n', end - pos));
+        if (!nl) {
+            pos = end;
+            break;
+        }
+        pos = nl - data + 1;
+        line++;
+        line_start = pos;
+    }
+}
+
+BufferLexer::Match BufferLexer::match_token() const {
+    size_t p = pos;
+    int c = peek(p);
+    auto one_of = [&](size_t len, size_t type) {
+        return Match{true, type, p + len};
+    };
+    // 'c2' if the character after 'c' is 'next', otherwise 'c1'
+    auto either = [&](int next, size_t c2, size_t c1) {
+        return peek(p + 1) == next ? one_of(2, c2) : one_of(1, c1);
+    };
+
+    if (is_identifier_start(c)) {
+        size_t end = p + 1;
+        while (is_identifier_char(peek(end)))
+            end++;
+        return {true, keyword_type(buffer.substr(p, end - p)), end};
+    }
+    if (is_digit(c) || (c == '.' && is_digit(peek(p + 1))))
+        return match_number();
+
+    switch (c) {
+        case ' ':
+        case '\t': {
+            size_t end = p + 1;
+            while (peek(end) == ' ' || peek(end) == '\t')
+                end++;
+            return {true, Skip, end};
+        }
+        case '\r':
+            return one_of(peek(p + 1) == '\n' ? 2 : 1, Skip);
+        case '\n':
+            return one_of(1, Skip);
+        case '\'':
+            return match_quoted('\'', CPMLexer::CharacterLiteral);
+        case '"':
+            return match_quoted('"', CPMLexer::StringLiteral);
+        case '(':
+            return one_of(1, CPMLexer::LeftParen);
+        case ')':
+            return one_of(1, CPMLexer::RightParen);
+        case '[':
+            return one_of(1, CPMLexer::LeftBracket);
+        case ']':
+            return one_of(1, CPMLexer::RightBracket);
+        case '{':
+            return one_of(1, CPMLexer::LeftBrace);
+        case '}':
+            return one_of(1, CPMLexer::RightBrace);
+        case '+':
+            if (peek(p + 1) == '+')
+                return one_of(2, CPMLexer::PlusPlus);
+            return either('=', CPMLexer::PlusAssign, CPMLexer::Plus);
+        case '-':
+            if (peek(p + 1) == '-')
+                return one_of(2, CPMLexer::MinusMinus);
+            if (peek(p + 1) == '>')
+                return one_of(2, CPMLexer::Arrow);
+            return either('=', CPMLexer::MinusAssign, CPMLexer::Minus);
+        case '*':
+            return either('=', CPMLexer::StarAssign, CPMLexer::Star);
+        case '/':
+            if (peek(p + 1) == '/') {
+                size_t end = p + 2;
+                while (end < buffer.size() && buffer[end] != '\r' && buffer[end] != '\n')
+                    end++;
+                return {true, Skip, end};
+            }
+            if (peek(p + 1) == '*') {
+                size_t close = buffer.find("*/", p + 2);
+                // an unterminated comment is just a division, antlr falls back to it as well
+                if (close != std::string_view::npos)
+                    return {true, Skip, close + 2};
+            }
+            return either('=', CPMLexer::DivAssign, CPMLexer::Div);
+        case '%':
+            return either('=', CPMLexer::ModAssign, CPMLexer::Mod);
+        case '^':
+            return either('=', CPMLexer::XorAssign, CPMLexer::Caret);
+        case '&':
+            if (peek(p + 1) == '&')
+                return one_of(2, CPMLexer::AndAnd);
+            return either('=', CPMLexer::AndAssign, CPMLexer::And);
+        case '|':
+            if (peek(p + 1) == '|')
+                return one_of(2, CPMLexer::OrOr);
+            return either('=', CPMLexer::OrAssign, CPMLexer::Or);
+        case '~':
+            return one_of(1, CPMLexer::Tilde);
+        case '!':
+            return either('=', CPMLexer::NotEqual, CPMLexer::Not);
+        case '=':
+            return either('=', CPMLexer::Equal, CPMLexer::Assign);
+        case '<':
+            // there's no '<<' token, "<<" are two 'Less' tokens
+            if (peek(p + 1) == '<' && peek(p + 2) == '=')
+                return one_of(3, CPMLexer::LeftShiftAssign);
+            return either('=', CPMLexer::LessEqual, CPMLexer::Less);
+        case '>':
+            if (peek(p + 1) == '>' && peek(p + 2) == '=')
+                return one_of(3, CPMLexer::RightShiftAssign);
+            return either('=', CPMLexer::GreaterEqual, CPMLexer::Greater);
+        case ',':
+            return one_of(1, CPMLexer::Comma);
+        case '?':
+            return one_of(1, CPMLexer::Question);
+        case ':':
+            return either(':', CPMLexer::Doublecolon, CPMLexer::Colon);
+        case ';':
+            return one_of(1, CPMLexer::Semi);
+        case '.':
+            if (peek(p + 1) == '.' && peek(p + 2) == '.')
+                return one_of(3, CPMLexer::Ellipsis);
+            return one_of(1, CPMLexer::Dot);
+        default:
+            return {false, Skip, p};
+    }
+}
+
+BufferLexer::Match BufferLexer::match_number() const {
+    size_t p = pos;
+    // the candidates are in the order of the rules in the grammar,
+    // a later one is taken only if it's longer
+    Match best{true, CPMLexer::IntegerLiteral, p};
+    auto candidate = [&](size_t type, size_t end) {
+        if (end > best.end)
+            best = {true, type, end};
+    };
+
+    // IntegerLiteral: DIGIT+
+    size_t end = p;
+    while (is_digit(peek(end)))
+        end++;
+    candidate(CPMLexer::IntegerLiteral, end);
+
+    // FloatingLiteral: 1.5e3f, 1.e3, .5, 1e3, ...
+    size_t digits_end = match_digit_sequence(p);
+    if (peek(digits_end) == '.') {
+        end = match_exponent(match_digit_sequence(digits_end + 1));
+        // '.' alone is not a number
+        if (end > p + 1) {
+            if (peek(end) == 'f' || peek(end) == 'l' || peek(end) == 'F' || peek(end) == 'L')
+                end++;
+            candidate(CPMLexer::FloatingLiteral, end);
+        }
+    } else if ((end = match_exponent(digits_end)) > digits_end) {
+        if (peek(end) == 'f' || peek(end) == 'l' || peek(end) == 'F' || peek(end) == 'L')
+            end++;
+        candidate(CPMLexer::FloatingLiteral, end);
+    }
+
+    if (peek(p) == '0') {
+        // OctalLiteral: 0, 017, 0'17
+        end = p + 1;
+        while (true) {
+            if (is_octal_digit(peek(end)))
+                end++;
+            else if (peek(end) == '\'' && is_octal_digit(peek(end + 1)))
+                end += 2;
+            else
+                break;
+        }
+        candidate(CPMLexer::OctalLiteral, end);
+
+        // HexadecimalLiteral: 0x1F, 0x1'F
+        if ((peek(p + 1) == 'x' || peek(p + 1) == 'X') && is_hex_digit(peek(p + 2))) {
+            end = p + 3;
+            while (true) {
+                if (is_hex_digit(peek(end)))
+                    end++;
+                else if (peek(end) == '\'' && is_hex_digit(peek(end + 1)))
+                    end += 2;
+                else
+                    break;
+            }
+            candidate(CPMLexer::HexadecimalLiteral, end);
+        }
+
+        // BinaryLiteral: 0b101, 0b1'0
+        if ((peek(p + 1) == 'b' || peek(p + 1) == 'B') && is_binary_digit(peek(p + 2))) {
+            end = p + 3;
+            while (true) {
+                if (is_binary_digit(peek(end)))
+                    end++;
+                else if (peek(end) == '\'' && is_binary_digit(peek(end + 1)))
+                    end += 2;
+                else
+                    break;
+            }
+            candidate(CPMLexer::BinaryLiteral, end);
+        }
+    }
+    return best;
+}
+
+size_t BufferLexer::match_digit_sequence(size_t i) const {
+    if (!is_digit(peek(i)))
+        return i;
+    i++;
+    while (true) {
+        if (is_digit(peek(i)))
+            i++;
+        else if (peek(i) == '\'' && is_digit(peek(i + 1)))
+            i += 2;
+        else
+            return i;
+    }
+}
+
+size_t BufferLexer::match_exponent(size_t i) const {
+    if (peek(i) != 'e' && peek(i) != 'E')
+        return i;
+    size_t digits = i + 1;
+    if (peek(digits) == '+' || peek(digits) == '-')
+        digits++;
+    size_t end = match_digit_sequence(digits);
+    return end > digits ? end : i;
+}
+
+size_t BufferLexer::match_escape(size_t i) const {
+    int c = peek(i + 1);
+    switch (c) {
+        case '\'':
+        case '"':
+        case '?':
+        case '\\':
+        case 'a':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+        case 'v':
+        case '\n':
+            return i + 2;
+        case '\r':
+            return peek(i + 2) == '\n' ? i + 3 : i + 2;
+        case 'x': {
+            size_t end = i + 2;
+            while (is_hex_digit(peek(end)))
+                end++;
+            return end > i + 2 ? end : i;
+        }
+        default: {
+            size_t end = i + 1;
+            while (end < i + 4 && is_octal_digit(peek(end)))
+                end++;
+            return end > i + 1 ? end : i;
+        }
+    }
+}
+
+BufferLexer::Match BufferLexer::match_quoted(char quote, size_t type) const {
+    size_t i = pos + 1;
+    // character literals can't be empty
+    bool empty_ok = quote == '"';
+    bool empty = true;
+    while (true) {
+        int c = peek(i);
+        if (c == quote && (empty_ok || !empty))
+            return {true, type, i + 1};
+        if (c == -1 || c == quote || c == '\r' || c == '\n')
+            return {false, Skip, i};
+        if (c == '\\') {
+            size_t end = match_escape(i);
+            // same position where antlr fails, after '\x' a hex digit is expected
+            if (end == i)
+                return {false, Skip, peek(i + 1) == 'x' ? i + 2 : i + 1};
+            i = end;
+        } else
+            i++;
+        empty = false;
+    }
+}
+
+void BufferLexer::report_error(size_t fail_index) {
+    if (!error_listener)
+        return;
+    std::string_view text = fail_index < buffer.size() ? buffer.substr(pos, fail_index - pos + 1)
+                                                       : buffer.substr(pos);
+    error_listener->syntaxError(nullptr, nullptr, line, pos - line_start,
+                                "token recognition error at: '" + error_display(text) + "'", nullptr);
+}
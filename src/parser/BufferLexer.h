@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "antlr4-runtime.h"
+#include "BufferCharStream.h"
+
+class BufferLexer;
+
+/**
+ * Token produced by BufferLexer.
+ *
+ * Instead of a copy of its text, the token only keeps the offsets of the text
+ * in the source buffer.
+ */
+class BufferToken : public antlr4::WritableToken {
+public:
+    BufferToken(BufferLexer *source, size_t type, size_t start, size_t stop, size_t line,
+                size_t char_position_in_line);
+
+    std::string getText() const override;
+
+    /**
+     * Text of the token without a copy, points into the source buffer.
+     */
+    std::string_view getTextView() const;
+
+    size_t getType() const override {
+        return type;
+    }
+
+    size_t getLine() const override {
+        return line;
+    }
+
+    size_t getCharPositionInLine() const override {
+        return char_position_in_line;
+    }
+
+    size_t getChannel() const override {
+        return channel;
+    }
+
+    size_t getTokenIndex() const override {
+        return token_index;
+    }
+
+    size_t getStartIndex() const override {
+        return start;
+    }
+
+    size_t getStopIndex() const override {
+        return stop;
+    }
+
+    antlr4::TokenSource *getTokenSource() const override;
+
+    antlr4::CharStream *getInputStream() const override;
+
+    void setText(const std::string &text) override;
+
+    void setType(size_t ttype) override {
+        type = ttype;
+    }
+
+    void setLine(size_t l) override {
+        line = l;
+    }
+
+    void setCharPositionInLine(size_t pos) override {
+        char_position_in_line = pos;
+    }
+
+    void setChannel(size_t c) override {
+        channel = c;
+    }
+
+    void setTokenIndex(size_t index) override {
+        token_index = index;
+    }
+
+    /**
+     * Same format as antlr4::CommonToken::toString.
+     */
+    std::string toString() const override;
+
+private:
+    BufferLexer *source;
+    size_t start;
+    // index of the last character, inclusive
+    size_t stop;
+    size_t token_index = antlr4::INVALID_INDEX;
+    // can't be narrower, EOF is the maximum of size_t
+    size_t type;
+    uint32_t line;
+    uint32_t char_position_in_line;
+    uint32_t channel = antlr4::Token::DEFAULT_CHANNEL;
+    // only set if the text was overwritten by setText
+    std::unique_ptr<std::string> custom_text;
+};
+
+/**
+ * Hand-written lexer for C+-, produces the same tokens as the CPMLexer generated
+ * from grammar/CPM.g4, but much faster.
+ *
+ * It reads the source buffer of a BufferCharStream directly and the tokens only point
+ * into the buffer, see BufferToken. The token types are the ones of CPMLexer, so
+ * it can be used as a token source for CPMParser.
+ *
+ * Like CPMLexer, it uses the longest match, and on equal length the rule that comes
+ * first in the grammar. Characters that don't start any token are reported as
+ * 'token recognition error' and skipped.
+ *
+ * Any change of the lexer rules in the grammar must be done here as well,
+ * tests/lexer.cpp compares both lexers.
+ */
+class BufferLexer : public antlr4::TokenSource {
+public:
+    /**
+     * @param error_listener listener for unrecognized characters, they're ignored if nullptr
+     */
+    explicit BufferLexer(BufferCharStream &input, antlr4::ANTLRErrorListener *error_listener = nullptr);
+
+    std::unique_ptr<antlr4::Token> nextToken() override;
+
+    size_t getLine() const override {
+        return line;
+    }
+
+    size_t getCharPositionInLine() override {
+        return pos - line_start;
+    }
+
+    antlr4::CharStream *getInputStream() override {
+        return &input;
+    }
+
+    std::string getSourceName() override {
+        return input.getSourceName();
+    }
+
+    antlr4::TokenFactory<antlr4::CommonToken> *getTokenFactory() override;
+
+    std::string_view getBuffer() const {
+        return buffer;
+    }
+
+private:
+    BufferCharStream &input;
+    std::string_view buffer;
+    antlr4::ANTLRErrorListener *error_listener;
+
+    // index of the next character
+    size_t pos = 0;
+    // current line, starting from 1 like in antlr
+    size_t line = 1;
+    // index where the current line starts
+    size_t line_start = 0;
+
+    /**
+     * @return the character at given index, or -1 past the end of the buffer
+     */
+    int peek(size_t i) const {
+        return i < buffer.size() ? static_cast<unsigned char>(buffer[i]) : -1;
+    }
+
+    /**
+     * Move to given index, keeps track of lines.
+     */
+    void advance_to(size_t end);
+
+    struct Match {
+        // false if the characters don't fit any token
+        bool ok;
+        // token type, 0 for whitespace and comments
+        size_t type;
+        // index after the token, or index of the first character that doesn't fit
+        // any token if there's no match
+        size_t end;
+    };
+
+    /**
+     * Match the token that starts at 'pos'.
+     */
+    Match match_token() const;
+
+    Match match_number() const;
+
+    /**
+     * Match a character or string literal: quote, characters or escape sequences
+     * (at least one for a character literal), quote.
+     */
+    Match match_quoted(char quote, size_t type) const;
+
+    /**
+     * Match an escape sequence that starts with a backslash at index i.
+     * @return index after the sequence, or i if there's no valid escape sequence
+     */
+    size_t match_escape(size_t i) const;
+
+    /**
+     * @return index after the longest digit sequence at index i, e.g. 1'000, or i if none
+     */
+    size_t match_digit_sequence(size_t i) const;
+
+    /**
+     * @return index after the exponent part at index i, e.g. e-10, or i if none
+     */
+    size_t match_exponent(size_t i) const;
+
+    /**
+     * Report unrecognized input from 'pos' to 'fail_index' (inclusive) to the listener.
+     */
+    void report_error(size_t fail_index);
+};
@@ -1,6 +1,7 @@
 #include <ostream>
 
 #include "ParseTreeVisitor.h"
+#include "ast/expr/ConstExprEvaluator.h"
 
 using namespace std;
 
@@ -281,7 +282,7 @@ ParserVisitor::visitDeclSpecifierSeq(CPMParser::DeclSpecifierSeqContext *ctx) {
 
 ast::node_ptr<ast::IdExpr> ParserVisitor::visitUnqualifiedId(CPMParser::UnqualifiedIdContext *ctx) {
     auto source_info = src_info(ctx);
-    return make_node<IdExpr>(std::move(source_info), ctx->getText());
+    return make_node<IdExpr>(std::move(source_info), context.intern(ctx->getText()));
 }
 
 ast::node_ptr<ast::IdExpr> ParserVisitor::visitIdExpression(CPMParser::IdExpressionContext *ctx) {
@@ -322,19 +323,21 @@ ParserVisitor::visitNoPointerDeclarator(CPMParser::NoPointerDeclaratorContext *c
 
         return make_node<FunctionDecl>(std::move(source_info),
                                        ft,
-                                       std::move(decl->id),
+                                       decl->id,
                                        std::move(paq.params));
     }
         // array npd
     else if (ctx->noPointerDeclarator() && ctx->LeftBracket() && ctx->RightBracket()) {
         optional<size_t> size;
         if (ctx->constantExpression()) {
-            // refactor: rewrite grammar to contain strictly a integer literal
+            // the names aren't known yet, so the size can't refer to const variables
             node_ptr<Expr> size_expr = visitConstantExpression(ctx->constantExpression());
-            if (auto il = get_if<IntLiteral>(size_expr.get()))
-                size = il->val;
-            else
-                report_error("array size something else than integer literal", ctx);
+            optional<ConstValue> val = ast::ConstExprEvaluator(false)(*size_expr);
+            if (!val || val->type == cpm::SimpleType::Builtin::Double)
+                report_error("array size is not an integral constant expression", ctx);
+            if (val->int_val < 0)
+                report_error("array size is negative", ctx);
+            size = val->int_val;
         }
         cpm::ArrayType *at = context.getArrayType(underlying_type, size);
         return visitNoPointerDeclarator(ctx->noPointerDeclarator(), at);
@@ -801,7 +804,8 @@ ast::AssignOp ParserVisitor::visitAssignmentOperator(CPMParser::AssignmentOperat
 void ParserVisitor::report_error(const string &msg, antlr4::ParserRuleContext *ctx) {
     ast::SourceInfo source_info = src_info(ctx);
     string err_msg = "line " + source_info.str() + ": error: " + msg;
-    err_msg += '\n' + context.getInputByLines().at(source_info.line_no);
+    err_msg += '\n';
+    err_msg += context.getLine(source_info.line_no);
     throw std::runtime_error(err_msg);
 }
 
@@ -812,7 +816,7 @@ void ParserVisitor::report_unhandled_case(const string &err_loc, antlr4::ParserR
 void ParserVisitor::warning(const string &msg, antlr4::ParserRuleContext *ctx) {
     size_t line_no = src_info(ctx).line_no;
     string err_msg = "line " + to_string(line_no) + ": warning: " + msg;
-    cout << err_msg << endl;
+    warning_os << err_msg << endl;
 }
 
 std::string ParserVisitor::visitClassName(CPMParser::ClassNameContext *ctx) {
@@ -879,7 +883,7 @@ ast::node_ptr<ast::ClassHead> ParserVisitor::visitClassHead(CPMParser::ClassHead
     auto source_info = src_info(ctx);
     return make_node<ClassHead>(std::move(source_info),
                                 visitClassKey(ctx->classKey()),
-                                visitClassHeadName(ctx->classHeadName()));
+                                context.intern(visitClassHeadName(ctx->classHeadName())));
 }
 
 ast::node_ptr<ast::ClassDef>
@@ -924,7 +928,7 @@ bool ParserVisitor::valid_array_elem_type(cpm::Type *type) {
 
 bool ParserVisitor::is_void(cpm::Type *type) {
     cpm::SimpleType *st;
-    return (st = cpm::simple_ty(type)) && st->getTypeId() == "void";
+    return (st = cpm::simple_ty(type)) && st->isBuiltin(cpm::SimpleType::Builtin::Void);
 }
 
 ast::node_ptr<ast::MemberSpecElem>
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <iostream>
 
 #include "utils/Context.h"
 #include "CPMParser.h"
@@ -17,8 +18,9 @@
 class ParserVisitor {
 public:
 
-    explicit ParserVisitor(cpm::Context &context) :
-            context(context) {};
+    explicit ParserVisitor(cpm::Context &context, std::ostream &warning_os = std::cout) :
+            context(context),
+            warning_os(warning_os) {};
 
     ast::node_ptr<ast::TranslationUnit>
     visitTranslationUnit(CPMParser::TranslationUnitContext *ctx);
@@ -193,7 +195,7 @@ private:
     [[noreturn]] void report_unhandled_case(const std::string &err_loc,
                                             antlr4::ParserRuleContext *ctx);
 
-    /* Reports a warning to std out. */
+    /* Reports a warning to warning_os. */
     void warning(const std::string &msg, antlr4::ParserRuleContext *ctx);
 
     /**
@@ -221,6 +223,7 @@ private:
     static ast::SourceInfo src_info(antlr4::ParserRuleContext *ctx);
 
     cpm::Context &context;
+    std::ostream &warning_os;
 
     cpm::SimpleType *
     getTypeFromSeq(const std::vector<std::string> &specs, antlr4::ParserRuleContext *ctx);
@@ -2,23 +2,83 @@
 #include "Parser.h"
 #include "parser/ParseTreeVisitor.h"
 #include "CPMParser.h"
-#include "CPMLexer.h"
+#include "BufferCharStream.h"
+#include "BufferLexer.h"
+#include "utils/Statistic.h"
 
-Parser::Parser(cpm::Context &context) :
-        context(context) {}
+namespace {
+    cpm::Statistic num_sll_parses("parser", "sll", "files parsed on the fast path (SLL prediction)");
+    cpm::Statistic num_ll_parses("parser", "ll", "files re-parsed with full LL prediction");
+
+    /**
+     * Same as antlr4::ConsoleErrorListener, but reports to given stream
+     * instead of std::cerr.
+     */
+    class StreamErrorListener : public antlr4::BaseErrorListener {
+    public:
+        explicit StreamErrorListener(std::ostream &os) :
+                os(os) {}
+
+        void syntaxError(antlr4::Recognizer *, antlr4::Token *, size_t line,
+                         size_t charPositionInLine, const std::string &msg,
+                         std::exception_ptr) override {
+            os << "line " << line << ":" << charPositionInLine << " " << msg << std::endl;
+        }
+
+    private:
+        std::ostream &os;
+    };
+}
+
+Parser::Parser(cpm::Context &context, std::ostream &warning_os, std::ostream &error_os) :
+        context(context),
+        warning_os(warning_os),
+        error_os(error_os) {}
 
 ast::node_ptr<ast::TranslationUnit> Parser::parse() const {
+    // all nodes are allocated here, the arena is handed over to the translation unit
+    auto arena = std::make_unique<ast::Arena>();
+    ast::Arena::Scope arena_scope(*arena);
+
     // antlr parsing classes
-    antlr4::ANTLRInputStream antlr_istream;
-    CPMLexer antlr_lexer(&antlr_istream);
+    // lexer reads straight from the source buffer of the context
+    BufferCharStream antlr_istream(context.getInput());
+    StreamErrorListener error_listener(error_os);
+    // hand-written lexer, much faster than the generated CPMLexer
+    BufferLexer antlr_lexer(antlr_istream, &error_listener);
     antlr4::CommonTokenStream antlr_tokens(&antlr_lexer);
     CPMParser antlr_parser(&antlr_tokens);
     CPMParser::TranslationUnitContext *tu_ctx;
     // parse tree visitor
-    ParserVisitor visitor{context};
+    ParserVisitor visitor{context, warning_os};
 
-    antlr_istream.load(context.getInput());
-    tu_ctx = antlr_parser.translationUnit();
+    // Two-stage parsing: SLL prediction is much faster than full LL prediction and
+    // it's enough for almost all inputs. It can fail on valid input though, so
+    // if it fails (for whatever reason), parse again with LL, which also
+    // reports the syntax errors. Errors are not reported during the first stage.
+    auto *interpreter = antlr_parser.getInterpreter<antlr4::atn::ParserATNSimulator>();
+    interpreter->setPredictionMode(antlr4::atn::PredictionMode::SLL);
+    antlr_parser.removeErrorListeners();
+    antlr_parser.setErrorHandler(std::make_shared<antlr4::BailErrorStrategy>());
+    try {
+        tu_ctx = antlr_parser.translationUnit();
+        last_stage = ParseStage::SLL;
+        ++num_sll_parses;
+    }
+    catch (const antlr4::ParseCancellationException &) {
+        // the tokens are already buffered, rewind them
+        antlr_tokens.seek(0);
+        antlr_parser.reset();
+        // the grammar's own state isn't reset, the second stage must not see the
+        // classes the first one declared, or a class could be used before its declaration
+        antlr_parser.user_types.clear();
+        antlr_parser.addErrorListener(&error_listener);
+        antlr_parser.setErrorHandler(std::make_shared<antlr4::DefaultErrorStrategy>());
+        interpreter->setPredictionMode(antlr4::atn::PredictionMode::LL);
+        tu_ctx = antlr_parser.translationUnit();
+        last_stage = ParseStage::LL;
+        ++num_ll_parses;
+    }
     if (antlr_parser.getNumberOfSyntaxErrors()) {
         throw Parser::SyntaxError("invalid syntax");
     }
@@ -30,6 +90,7 @@ ast::node_ptr<ast::TranslationUnit> Parser::parse() const {
     catch (const std::exception &e) {
         throw Parser::VisitError(e.what());
     }
+    tu->arena = std::move(arena);
 
     return tu;
 }
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include <iostream>
 
 #include "utils/Context.h"
 #include "ast/TranslationUnit.h"
@@ -12,10 +13,35 @@ namespace cpm {
 
 class Parser {
 public:
-    Parser(cpm::Context &context);
+    /**
+     * @param warning_os stream for warnings about the source code
+     * @param error_os   stream for syntax errors reported by antlr
+     */
+    explicit Parser(cpm::Context &context,
+                    std::ostream &warning_os = std::cout,
+                    std::ostream &error_os = std::cerr);
 
     ast::node_ptr<ast::TranslationUnit> parse() const;
 
+    /**
+     * Prediction mode that produced the parse tree, see parse().
+     */
+    enum class ParseStage {
+        // not parsed yet
+        None,
+        // the fast path, SLL prediction succeeded
+        SLL,
+        // SLL prediction failed, the input was parsed again with full LL prediction
+        LL
+    };
+
+    /**
+     * Which prediction mode the last call to parse() ended with.
+     */
+    ParseStage getParseStage() const {
+        return last_stage;
+    }
+
     class SyntaxError : public std::runtime_error {
     public:
         using std::runtime_error::runtime_error;
@@ -28,4 +54,7 @@ public:
 
 private:
     cpm::Context &context;
+    std::ostream &warning_os;
+    std::ostream &error_os;
+    mutable ParseStage last_stage = ParseStage::None;
 };
@@ -0,0 +1,282 @@
+#include "EffectsAnalysis.h"
+
+#include <algorithm>
+
+#include "utils/Statistic.h"
+
+using namespace cpm::sc;
+using ast::MemoryEffect;
+
+namespace {
+    cpm::Statistic num_readnone("sema", "readnone-functions",
+                                "functions that don't access memory");
+    cpm::Statistic num_readonly("sema", "readonly-functions",
+                                "functions that only read memory");
+    cpm::Statistic num_norecurse("sema", "norecurse-functions",
+                                 "functions that are never called recursively");
+}
+
+void EffectsAnalysis::run(ast::TranslationUnit &tu) {
+    for (const auto &d: tu.declars) {
+        if (auto *simple_declar = get_if<ast::SimpleDeclar>(d.get()))
+            declare(*simple_declar);
+        else if (auto *func_def = get_if<ast::FuncDef>(d.get()))
+            define(*func_def);
+        else if (auto *class_def = get_if<ast::ClassDef>(d.get()))
+            declare(*class_def);
+    }
+
+    for (const ast::FunctionDecl *decl: definitions) {
+        Function &func = functions.at(decl);
+        if (func.index == 0)
+            strong_connect(decl, func);
+    }
+
+    for (ast::FunctionDecl *decl: declarations) {
+        auto it = functions.find(first_declaration(decl));
+        if (it == functions.end())
+            continue;
+        decl->memory = it->second.memory;
+        decl->norecurse = it->second.norecurse;
+    }
+    for (const ast::FunctionDecl *decl: definitions) {
+        const Function &func = functions.at(decl);
+        if (func.memory == MemoryEffect::None)
+            ++num_readnone;
+        else if (func.memory == MemoryEffect::Read)
+            ++num_readonly;
+        if (func.norecurse)
+            ++num_norecurse;
+    }
+}
+
+void EffectsAnalysis::declare(ast::SimpleDeclar &node) {
+    for (const auto &init_declar: node.init_declars) {
+        ast::Decl *decl = init_declar->declarator.get();
+        if (auto *func_decl = dynamic_cast<ast::FunctionDecl *>(decl))
+            declarations.push_back(func_decl);
+        else
+            global_vars.insert(decl);
+    }
+}
+
+void EffectsAnalysis::declare(ast::ClassDef &node) {
+    if (!node.body)
+        return;
+    for (const auto &elem: node.body.value()->list) {
+        auto *member_declar = get_if<ast::MemberDeclaration>(elem.get());
+        if (!member_declar)
+            continue;
+        if (auto *func_def = get_if<ast::FuncDef>(member_declar))
+            define(*func_def);
+        else
+            for (const auto &decl: get<ast::MemberDeclaratorList>(*member_declar).decls)
+                if (auto *func_decl = dynamic_cast<ast::FunctionDecl *>(decl.get()))
+                    declarations.push_back(func_decl);
+    }
+}
+
+void EffectsAnalysis::define(ast::FuncDef &node) {
+    declarations.push_back(node.declarator.get());
+    const ast::FunctionDecl *decl = first_declaration(node.declarator.get());
+    definitions.push_back(decl);
+    current = &functions[decl];
+    (*this)(*node.body->comp_stmt);
+    current = nullptr;
+}
+
+void EffectsAnalysis::strong_connect(const ast::FunctionDecl *decl, Function &func) {
+    func.index = func.low_link = next_index++;
+    stack.push_back(decl);
+    func.on_stack = true;
+    for (const ast::FunctionDecl *callee: func.callees) {
+        auto it = functions.find(callee);
+        if (it == functions.end())
+            continue;
+        Function &callee_func = it->second;
+        if (callee_func.index == 0) {
+            strong_connect(callee, callee_func);
+            func.low_link = std::min(func.low_link, callee_func.low_link);
+        } else if (callee_func.on_stack)
+            func.low_link = std::min(func.low_link, callee_func.index);
+    }
+    if (func.low_link != func.index)
+        return;
+
+    // this is the root of a component, the component is on the stack above it;
+    // every callee on the stack is in the component, the other components are done
+    size_t begin = stack.size() - 1;
+    while (stack[begin] != decl)
+        begin--;
+    MemoryEffect memory = MemoryEffect::None;
+    bool norecurse = begin == stack.size() - 1;
+    bool calls_back = false;
+    for (size_t i = begin; i < stack.size(); i++) {
+        const Function &member = functions.at(stack[i]);
+        memory = std::max(memory, member.memory);
+        for (const ast::FunctionDecl *callee: member.callees) {
+            auto it = functions.find(callee);
+            // not defined here, it may do anything
+            if (it == functions.end()) {
+                memory = MemoryEffect::ReadWrite;
+                calls_back = calls_back || !callee->norecurse;
+            } else if (it->second.on_stack)
+                norecurse = false;
+            // the other components can't call this one, unless through an unknown function
+            else {
+                memory = std::max(memory, it->second.memory);
+                calls_back = calls_back || it->second.calls_back;
+            }
+        }
+    }
+    for (size_t i = begin; i < stack.size(); i++) {
+        Function &member = functions.at(stack[i]);
+        member.memory = memory;
+        member.norecurse = norecurse && !calls_back;
+        member.calls_back = calls_back;
+        member.on_stack = false;
+    }
+    stack.resize(begin);
+}
+
+void EffectsAnalysis::add_effect(MemoryEffect effect) {
+    current->memory = std::max(current->memory, effect);
+}
+
+void EffectsAnalysis::write(const ast::Expr &lvalue) {
+    if (!is_local(lvalue))
+        add_effect(MemoryEffect::ReadWrite);
+    (*this)(lvalue);
+}
+
+bool EffectsAnalysis::is_local(const ast::Expr &lvalue) const {
+    const auto *id_expr = get_if<ast::IdExpr>(&lvalue);
+    return id_expr && !global_vars.contains(id_expr->var.value());
+}
+
+void EffectsAnalysis::operator()(const ast::BinaryExpr &node) {
+    (*this)(*node.lhs);
+    (*this)(*node.rhs);
+}
+
+void EffectsAnalysis::operator()(const ast::AssignmentExpr &node) {
+    write(*node.lhs);
+    (*this)(*node.rhs);
+}
+
+void EffectsAnalysis::operator()(const ast::CommaExpr &node) {
+    for (const auto &e: node.expressions)
+        (*this)(*e);
+}
+
+void EffectsAnalysis::operator()(const ast::CallExpr &node) {
+    current->callees.push_back(first_declaration(node.func.value()));
+    if (const auto *method_call = get_if<ast::MemberAccessExpr>(node.called_func.get()))
+        (*this)(*method_call->object);
+    for (const auto &arg: node.args)
+        (*this)(*arg);
+}
+
+void EffectsAnalysis::operator()(const ast::SubscriptExpr &node) {
+    (*this)(*node.dest);
+    (*this)(*node.index);
+}
+
+void EffectsAnalysis::operator()(const ast::TernaryExpr &node) {
+    (*this)(*node.cond);
+    (*this)(*node.then);
+    (*this)(*node.else_);
+}
+
+void EffectsAnalysis::operator()(const ast::PostIncrExpr &node) {
+    write(*node.expr);
+}
+
+void EffectsAnalysis::operator()(const ast::UnaryExpr &node) {
+    if (node.op == ast::PlusPlus || node.op == ast::MinusMinus)
+        write(*node.expr);
+    else
+        (*this)(*node.expr);
+}
+
+void EffectsAnalysis::operator()(const ast::CastExpr &node) {
+    (*this)(*node.expr);
+}
+
+void EffectsAnalysis::operator()(const ast::MemberAccessExpr &node) {
+    (*this)(*node.object);
+}
+
+void EffectsAnalysis::operator()(const ast::DefaultArgExpr &node) {
+    (*this)(*node.expr);
+}
+
+void EffectsAnalysis::operator()(const ast::ImplicitTypeCastExpr &node) {
+    (*this)(*node.val);
+}
+
+void EffectsAnalysis::operator()(const ast::LValToRValExpr &node) {
+    if (!is_local(*node.val))
+        add_effect(MemoryEffect::Read);
+    (*this)(*node.val);
+}
+
+void EffectsAnalysis::operator()(const ast::ArrToPtrExpr &node) {
+    (*this)(*node.arr_expr);
+}
+
+void EffectsAnalysis::operator()(const ast::DeclarStmt &node) {
+    (*this)(*node.declaration);
+}
+
+void EffectsAnalysis::operator()(const ast::ExprStmt &node) {
+    if (node.expr)
+        (*this)(*node.expr.value());
+}
+
+void EffectsAnalysis::operator()(const ast::ReturnStmt &node) {
+    if (node.expr)
+        (*this)(*node.expr.value());
+}
+
+void EffectsAnalysis::operator()(const ast::CompoundStmt &node) {
+    for (const auto &s: node.statements)
+        (*this)(*s);
+}
+
+void EffectsAnalysis::operator()(const ast::DoWhileStmt &node) {
+    (*this)(*node.body);
+    (*this)(*node.cond);
+}
+
+void EffectsAnalysis::operator()(const ast::ForStmt &node) {
+    std::visit(*this, *node.initStmt);
+    if (node.cond)
+        (*this)(*node.cond.value());
+    if (node.post_iter)
+        (*this)(*node.post_iter.value());
+    (*this)(*node.body);
+}
+
+void EffectsAnalysis::operator()(const ast::IfStmt &node) {
+    (*this)(*node.cond);
+    (*this)(*node.body);
+    if (node.else_body)
+        (*this)(*node.else_body.value());
+}
+
+void EffectsAnalysis::operator()(const ast::WhileStmt &node) {
+    (*this)(*node.cond);
+    (*this)(*node.body);
+}
+
+void EffectsAnalysis::operator()(const ast::SimpleDeclar &node) {
+    // local variables, the initialization is a store to the local
+    for (const auto &init_declar: node.init_declars)
+        if (init_declar->initializer)
+            (*this)(*init_declar->initializer.value());
+}
+
+void EffectsAnalysis::operator()(const ast::Condition &node) {
+    (*this)(*node.expr);
+}
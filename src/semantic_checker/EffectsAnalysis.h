@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ast/all_headers.h"
+
+namespace cpm::sc {
+    /**
+     * Interprocedural analysis of what the functions of a checked translation unit do,
+     * over its call graph.
+     *
+     * A function reads memory if it loads anything else than its local variables and
+     * parameters, it writes memory if it stores anywhere else. The stack slots of the
+     * locals aren't visible to the callers, a pointer to them can only be used by
+     * a function that reads or writes memory itself. A caller has the effects of the
+     * functions it calls; functions without a body (the c library, functions defined
+     * by another translation unit) may do anything.
+     *
+     * Mutually recursive functions have the same effects, so the functions are processed
+     * by strongly connected components of the call graph (Tarjan's algorithm), callees
+     * first. A function is norecurse when its component is just itself, it doesn't call
+     * itself and nothing it calls may call an unknown function.
+     *
+     * The results are saved in ast::FunctionDecl::memory and ast::FunctionDecl::norecurse
+     * of all declarations of the function, LLBuilder turns them into llvm attributes.
+     */
+    class EffectsAnalysis {
+    public:
+        /**
+         * Analyse the defined functions, the translation unit must be free of errors.
+         */
+        void run(ast::TranslationUnit &tu);
+
+        /* expressions */
+        void operator()(const ast::Expr &node) {
+            std::visit(*this, node);
+        }
+
+        void operator()(const ast::IntLiteral &) {}
+
+        void operator()(const ast::CharLiteral &) {}
+
+        void operator()(const ast::BoolLiteral &) {}
+
+        void operator()(const ast::FloatLiteral &) {}
+
+        void operator()(const ast::StringLiteral &) {}
+
+        void operator()(const ast::NullptrLiteral &) {}
+
+        // the address of a variable, the value is read by ast::LValToRValExpr
+        void operator()(const ast::IdExpr &) {}
+
+        void operator()(const ast::ThisExpr &) {}
+
+        void operator()(const ast::SizeofTypeExpr &) {}
+
+        void operator()(const ast::ImplicitThisExpr &) {}
+
+        void operator()(const ast::BinaryExpr &node);
+
+        void operator()(const ast::AssignmentExpr &node);
+
+        void operator()(const ast::CommaExpr &node);
+
+        void operator()(const ast::CallExpr &node);
+
+        void operator()(const ast::SubscriptExpr &node);
+
+        void operator()(const ast::TernaryExpr &node);
+
+        void operator()(const ast::PostIncrExpr &node);
+
+        void operator()(const ast::UnaryExpr &node);
+
+        void operator()(const ast::CastExpr &node);
+
+        void operator()(const ast::MemberAccessExpr &node);
+
+        void operator()(const ast::DefaultArgExpr &node);
+
+        void operator()(const ast::ImplicitTypeCastExpr &node);
+
+        void operator()(const ast::LValToRValExpr &node);
+
+        void operator()(const ast::ArrToPtrExpr &node);
+
+        // the folded expression isn't evaluated at runtime
+        void operator()(const ast::ConstantExpr &) {}
+
+        /* statements */
+        void operator()(const ast::Stmt &node) {
+            std::visit(*this, node);
+        }
+
+        void operator()(const ast::DeclarStmt &node);
+
+        void operator()(const ast::ExprStmt &node);
+
+        void operator()(const ast::BreakStmt &) {}
+
+        void operator()(const ast::ContinueStmt &) {}
+
+        void operator()(const ast::ReturnStmt &node);
+
+        void operator()(const ast::CompoundStmt &node);
+
+        void operator()(const ast::DoWhileStmt &node);
+
+        void operator()(const ast::ForStmt &node);
+
+        void operator()(const ast::IfStmt &node);
+
+        void operator()(const ast::WhileStmt &node);
+
+        void operator()(const ast::SimpleDeclar &node);
+
+        void operator()(const ast::Condition &node);
+
+    private:
+        /**
+         * A defined function, a node of the call graph.
+         */
+        struct Function {
+            // effects of the body itself, of the whole component once it's processed
+            ast::MemoryEffect memory = ast::MemoryEffect::None;
+            bool norecurse = false;
+            // whether the component calls a function without a body, which may call any
+            // function of the program back (the c library doesn't, see SemanticChecker)
+            bool calls_back = false;
+            // first declarations of the called functions
+            std::vector<const ast::FunctionDecl *> callees;
+            // Tarjan's algorithm, 0 for a function that hasn't been visited yet
+            size_t index = 0;
+            size_t low_link = 0;
+            bool on_stack = false;
+        };
+
+        // by the first declaration
+        std::unordered_map<const ast::FunctionDecl *, Function> functions;
+        // first declarations of the defined functions, in the order of the definitions
+        std::vector<const ast::FunctionDecl *> definitions;
+        // all function declarations, the results are copied to them
+        std::vector<ast::FunctionDecl *> declarations;
+        std::unordered_set<const ast::Decl *> global_vars;
+        // function whose body is being analysed
+        Function *current = nullptr;
+
+        // Tarjan's algorithm
+        size_t next_index = 1;
+        std::vector<const ast::FunctionDecl *> stack;
+
+        void declare(ast::SimpleDeclar &node);
+
+        void declare(ast::ClassDef &node);
+
+        void define(ast::FuncDef &node);
+
+        /**
+         * Find the components reachable from the function and compute their effects.
+         */
+        void strong_connect(const ast::FunctionDecl *decl, Function &func);
+
+        void add_effect(ast::MemoryEffect effect);
+
+        /**
+         * Expression that is stored to.
+         */
+        void write(const ast::Expr &lvalue);
+
+        /**
+         * @return whether the lvalue is a local variable or parameter of the current function
+         */
+        bool is_local(const ast::Expr &lvalue) const;
+
+        static const ast::FunctionDecl *first_declaration(const ast::FunctionDecl *decl) {
+            return decl->orig.value_or(decl);
+        }
+    };
+}
@@ -1,8 +1,55 @@
 #include "SemanticChecker.h"
 
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include "ast/expr/ConstExprEvaluator.h"
+#include "utils/Statistic.h"
+#include "EffectsAnalysis.h"
+
 using namespace std;
 using namespace cpm::sc;
 
+namespace {
+    cpm::Statistic num_conversion_queries("sema", "conversion-queries",
+                                          "implicit conversions checked");
+    cpm::Statistic num_conversion_cache_hits("sema", "conversion-cache-hits",
+                                             "implicit conversions answered from the cache");
+    cpm::Statistic num_bin_op_queries("sema", "bin-op-queries",
+                                      "binary operator conversions checked");
+    cpm::Statistic num_bin_op_cache_hits("sema", "bin-op-cache-hits",
+                                         "binary operator conversions answered from the cache");
+    cpm::Statistic num_folded_exprs("sema", "folded-expressions",
+                                    "expressions evaluated at compile time");
+}
+
+template<typename Check>
+void SemanticChecker::recover(Check &&check) {
+    // the state that's changed on the way down the ast and restored on the way back
+    Scope *scope = current_scope;
+    cpm::Symbol klass = defined_class;
+    ast::AccessModifier access = current_access;
+    cpm::Type *ret_type = curr_ret_type;
+    size_t loops = loop_level;
+    bool new_scope = cs_new_scope;
+    try {
+        check();
+    }
+    catch (const SemanticError &) {
+        if (shared->stop_at_max_errors && max_errors != 0 && shared->num_errors >= max_errors)
+            throw;
+        current_scope = scope;
+        defined_class = klass;
+        current_access = access;
+        curr_ret_type = ret_type;
+        loop_level = loops;
+        cs_new_scope = new_scope;
+    }
+}
+
 ast::node_ptr<ast::Expr> SemanticChecker::convert_error(
         SemanticChecker::Value from, cpm::Type *dest,
         const ast::Node &node, bool throw_error) {
@@ -84,7 +131,7 @@ SemanticChecker::Value SemanticChecker::operator()(ast::CommaExpr &node) {
 }
 
 SemanticChecker::Value SemanticChecker::operator()(ast::CallExpr &node) {
-    std::string func_name;
+    cpm::Symbol func_name;
     vector<Value> args;
     // this is used exclusively for overload resolution, should not be used later;
     // the size() can be +1 of args in case of member access call
@@ -98,11 +145,11 @@ SemanticChecker::Value SemanticChecker::operator()(ast::CallExpr &node) {
         func_name = id_expr->id;
         offset = 0;
         // constructor
-        if (classes.contains(func_name)) {
+        if (Class *klass = find_class(func_name)) {
             node.ctor_call = true;
             arg_types.push_back(getPointerType(getSimpleType(func_name, false), true));
             offset = 1;
-            scope = classes.at(func_name).get();
+            scope = klass;
         }
         // normal function call
         else {
@@ -219,8 +266,12 @@ SemanticChecker::Value SemanticChecker::operator()(ast::TernaryExpr &node) {
     // note: I'm not sure that they have to be exactly of the same type, this
     //      might skip over some viable cases
     if (then.type == else_.type)
-        if (then.valtype == LValue && else_.valtype == LValue)
+        if (then.valtype == LValue && else_.valtype == LValue) {
+            // the result is the address of one of them, picked at runtime
+            mark_address_taken(*node.then);
+            mark_address_taken(*node.else_);
             return {then.type, LValue};
+        }
 
     node.then = convert_to_rval(std::move(node.then), then, common_type, node);
     node.else_ = convert_to_rval(std::move(node.else_), else_, common_type, node);
@@ -276,11 +327,35 @@ bool SemanticChecker::viable_incr_type(cpm::Type *t) {
         return true;
     // bool is not viable to increment not according to C++17
     if (cpm::SimpleType *st = cpm::simple_ty(t))
-        if (is_integral(st) && st->getTypeId() != "bool")
+        if (is_integral(st) && !is_bool(st))
             return true;
     return false;
 }
 
+void SemanticChecker::mark_address_taken(const ast::Expr &lvalue) {
+    if (const auto *id_expr = get_if<ast::IdExpr>(&lvalue)) {
+        if (!id_expr->var.has_value())
+            return;
+        // globals are always in memory; they're also shared by the bodies checked
+        // in parallel, so they're not written to
+        for (const ScopeValue &v: global_scope->getValues(id_expr->id, false))
+            if (v.decl == id_expr->var.value())
+                return;
+        // the declaration is a part of the ast being checked
+        const_cast<ast::Decl *>(id_expr->var.value())->address_taken = true;
+    } else if (const auto *assign = get_if<ast::AssignmentExpr>(&lvalue))
+        mark_address_taken(*assign->lhs);
+    else if (const auto *unary = get_if<ast::UnaryExpr>(&lvalue)) {
+        if (unary->op == ast::PlusPlus || unary->op == ast::MinusMinus)
+            mark_address_taken(*unary->expr);
+    } else if (const auto *comma = get_if<ast::CommaExpr>(&lvalue))
+        mark_address_taken(*comma->expressions.back());
+    else if (const auto *ternary = get_if<ast::TernaryExpr>(&lvalue)) {
+        mark_address_taken(*ternary->then);
+        mark_address_taken(*ternary->else_);
+    }
+}
+
 SemanticChecker::Value SemanticChecker::operator()(ast::UnaryExpr &node) {
     Value expr = process(node.expr, node.op != ast::UnAnd && node.op != ast::Sizeof);
     switch (node.op) {
@@ -294,6 +369,7 @@ SemanticChecker::Value SemanticChecker::operator()(ast::UnaryExpr &node) {
         case ast::UnAnd:
             if (expr.valtype != LValue)
                 error("cannot take address of " + expr.str(), node);
+            mark_address_taken(*node.expr);
             return {getPointerType(expr.type, false), RValue};
         case ast::UnPlus:
             node.expr = convert_to_rval(std::move(node.expr), expr, expr.type, node);
@@ -335,8 +411,9 @@ bool SemanticChecker::is_integral(cpm::Type *type) {
 bool SemanticChecker::is_integral(cpm::SimpleType *simple_ty) {
     if (!simple_ty)
         return false;
-    const string &id = simple_ty->getTypeId();
-    return id == "int" || id == "char" || id == "bool";
+    SimpleType::Builtin b = simple_ty->getBuiltin();
+    return b == SimpleType::Builtin::Int || b == SimpleType::Builtin::Char ||
+           b == SimpleType::Builtin::Bool;
 }
 
 void SemanticChecker::operator()(ast::BreakStmt &node) {
@@ -369,7 +446,7 @@ bool SemanticChecker::is_void(cpm::Type *type) {
 }
 
 bool SemanticChecker::is_void(cpm::SimpleType *simple_ty) {
-    return simple_ty && simple_ty->getTypeId() == "void";
+    return simple_ty && simple_ty->isBuiltin(SimpleType::Builtin::Void);
 }
 
 void SemanticChecker::operator()(ast::CompoundStmt &node) {
@@ -381,7 +458,7 @@ void SemanticChecker::operator()(ast::CompoundStmt &node) {
         cs_new_scope = true;
 
     for (auto &s: node.statements)
-        process(*s);
+        recover([&] { process(*s); });
 
     if (added_scope)
         dropScope();
@@ -434,24 +511,28 @@ void SemanticChecker::operator()(ast::Condition &node) {
 }
 
 SemanticChecker::Value SemanticChecker::operator()(ast::IdExpr &node) {
-    vector<ScopeValue> vals = current_scope->getValues(node.id, true);
+    std::span<const ScopeValue> vals = current_scope->getValues(node.id, true, visible_before);
     if (vals.empty())
-        error("unknown identifier: '" + node.id + "'", node);
+        error("unknown identifier: '" + node.id.str() + "'", node);
     else if (vals.size() > 1)
-        error("multiple values under id: '" + node.id + "'", node);
+        error("multiple values under id: '" + node.id.str() + "'", node);
     if (cpm::function_ty(vals[0].decl->type))
         error("function used in a different context than function call", node);
     node.var = vals[0].decl;
     return {vals[0].type, LValue};
 }
 
-bool SemanticChecker::type_exists(const string &type_id) {
-    return type_id == "double" ||
-           type_id == "int" ||
-           type_id == "char" ||
-           type_id == "bool" ||
-           type_id == "void" ||
-           classes.contains(type_id);
+bool SemanticChecker::type_exists(const cpm::SimpleType *type) {
+    // the builtin is resolved when the type is created, only classes are looked up
+    switch (type->getBuiltin()) {
+        case cpm::SimpleType::Builtin::None:
+            return find_class(type->getTypeId()) != nullptr;
+        case cpm::SimpleType::Builtin::Nullptr:
+            // the type of nullptr can't be named
+            return false;
+        default:
+            return true;
+    }
 }
 
 void SemanticChecker::operator()(ast::DeclarStmt &node) {
@@ -480,9 +561,9 @@ void SemanticChecker::operator()(ast::InitDeclarator &node) {
         error("cannot declare variable of type 'void'", node);
 
     if (current_scope->contains(decl->id))
-        error("redeclaration of name '" + decl->id + "'", node);
+        error("redeclaration of name '" + decl->id.str() + "'", node);
 
-    current_scope->addValue(decl->id, decl->type, node.declarator.get());
+    current_scope->addValue(decl->id, decl->type, node.declarator.get(), declaration_order());
 
     if (node.initializer) {
         // note: c++ would not decay string literal array to pointer here, but we do
@@ -493,6 +574,9 @@ void SemanticChecker::operator()(ast::InitDeclarator &node) {
         if (node.initializer == nullptr)
             error("cannot initialize value of type " + cpm::to_string(decl->type) + " with " +
                   init.str(), node);
+        // the uses of a const variable are folded to its value
+        if (is_const(decl->type))
+            decl->const_value = ast::ConstExprEvaluator(true)(*node.initializer.value());
     }
 }
 
@@ -513,7 +597,7 @@ void SemanticChecker::operator()(ast::TranslationUnit &node) {
     global_scope = addScope();
     add_builtin_functions(node);
     for (const auto &d: node.declars)
-        process(*d);
+        recover([&] { process(*d); });
 }
 
 bool SemanticChecker::is_const(cpm::Type *type) {
@@ -567,15 +651,15 @@ SemanticChecker::declareFunction(ast::FunctionDecl *func_decl, bool process_def_
 }
 
 const ast::FunctionDecl *SemanticChecker::addFunctionToScope(const ast::FunctionDecl *func_decl) {
-    const string &id = func_decl->id;
+    cpm::Symbol id = func_decl->id;
     cpm::FunctionType *func_type = cpm::function_ty(func_decl->type);
     assert(func_type);
-    vector<ScopeValue> functions = current_scope->getValues(id, false);
+    std::span<const ScopeValue> functions = current_scope->getValues(id, false);
     if (!functions.empty()) {
         if (!cpm::function_ty(functions[0].type))
-            error("'" + id + "' already declared as a different kind of symbol", *func_decl);
+            error("'" + id.str() + "' already declared as a different kind of symbol", *func_decl);
         // compare each known overload
-        for (const auto &[decl, type]: functions) {
+        for (const auto &[decl, type, order]: functions) {
             cpm::FunctionType *cmp_func = cpm::function_ty(type);
             assert(cmp_func);
             switch (cmpFuncSignatures(func_type, cmp_func)) {
@@ -594,9 +678,10 @@ const ast::FunctionDecl *SemanticChecker::addFunctionToScope(const ast::Function
     }
     // class methods differentiate between public and private
     if (defined_class.empty())
-        current_scope->addValue(id, func_type, func_decl);
+        current_scope->addValue(id, func_type, func_decl, declaration_order());
     else
-        classes[defined_class]->addValue(id, func_type, func_decl, current_access);
+        classes.at(defined_class)->addValue(id, func_type, func_decl, current_access,
+                                            declaration_order());
     funcs_def_args[func_decl] = vector<ast::Expr *>(func_type->getParams().size(), nullptr);
     return func_decl;
 }
@@ -616,7 +701,7 @@ void SemanticChecker::operator()(ast::FuncDef &node) {
 
     // handle redefinition
     if (defined_funcs.contains(orig_decl))
-        error("redefinition of function '" + func_decl->id + "'", node);
+        error("redefinition of function '" + func_decl->id.str() + "'", node);
     else
         defined_funcs.insert(orig_decl);
 
@@ -629,7 +714,14 @@ void SemanticChecker::operator()(ast::FuncDef &node) {
         // or something, because we need the (lack of) const qualifiers from the most recent
         // param_decl
         current_scope->addValue(param->declarator->id, param->declarator->type,
-                                param->declarator.get());
+                                param->declarator.get(), declaration_order());
+    }
+    if (threads > 1) {
+        // checked by the workers once everything is declared
+        deferred_bodies.push_back({&node, current_scope, defined_class, func_type->getRetType(),
+                                   next_order});
+        dropScope();
+        return;
     }
     cs_new_scope = false;
     curr_ret_type = func_type->getRetType();
@@ -652,19 +744,19 @@ SemanticChecker::cmpFuncSignatures(cpm::FunctionType *t1, cpm::FunctionType *t2)
 }
 
 ScopeValue
-SemanticChecker::resolveCallOverload(const std::string &func_name, Scope *scope,
+SemanticChecker::resolveCallOverload(cpm::Symbol func_name, Scope *scope,
                                      const vector<cpm::Type *> &arg_types,
                                      const ast::CallExpr &node) {
     const size_t arg_count = arg_types.size();
-    vector<ScopeValue> candidates = scope->getValues(func_name, true);
+    std::span<const ScopeValue> candidates = scope->getValues(func_name, true, visible_before);
     // the vector<TypeMatch> says how well individual args match to the params
     vector<pair<ScopeValue, vector<TypeMatch>>> viable_candidates;
 
-    for (const auto &[decl, type]: candidates) {
+    for (const auto &[decl, type, order]: candidates) {
         cpm::FunctionType *func_type = cpm::function_ty(type);
         assert(func_type);
         const std::vector<cpm::Type *> &params = func_type->getParams();
-        const auto &def_args = funcs_def_args[decl];
+        const auto &def_args = funcs_def_args.at(decl);
         // too many arguments, no vararg
         if (arg_count > params.size() && !func_type->isVararg())
             continue;
@@ -686,7 +778,7 @@ SemanticChecker::resolveCallOverload(const std::string &func_name, Scope *scope,
         viable_candidates.emplace_back(ScopeValue{decl, func_type}, std::move(arg_matches));
     }
     if (viable_candidates.empty())
-        error("no matching function for call of '" + func_name + "'", node);
+        error("no matching function for call of '" + func_name.str() + "'", node);
     // select the best match
     // graph problem: in a directed graph, is there a node which receives an edge from every other
     //                node, and does not have any outgoing edges?
@@ -710,6 +802,18 @@ SemanticChecker::resolveCallOverload(const std::string &func_name, Scope *scope,
 
 SemanticChecker::TypeMatch
 SemanticChecker::implicitly_convertible(cpm::Type *start, cpm::Type *dest) {
+    conversion_queries++;
+    auto [it, inserted] = conversion_cache.try_emplace({start, dest}, NONE);
+    if (!inserted) {
+        conversion_cache_hits++;
+        return it->second;
+    }
+    // compute_implicit_conversion doesn't touch the cache, so the iterator stays valid
+    return it->second = compute_implicit_conversion(start, dest);
+}
+
+SemanticChecker::TypeMatch
+SemanticChecker::compute_implicit_conversion(cpm::Type *start, cpm::Type *dest) {
     if (const_unqualified_type(start) == const_unqualified_type(dest))
         return EXACT;
     else if (const_stronger_elem_type(dest, start))
@@ -722,7 +826,7 @@ SemanticChecker::implicitly_convertible(cpm::Type *start, cpm::Type *dest) {
             // 'T*' -> 'void*'
             (start_ptr && dest_ptr && is_void(dest_ptr->getElemType())) ||
             // 'nullptr_t' -> 'T*'
-            (dest_ptr && start_st && start_st->getTypeId() == "nullptr_t") ||
+            (dest_ptr && is_nullptr(start_st)) ||
             // to bool
             (is_bool(dest_st) && (start_ptr || is_numerical(start_st))) ||
             // integral promotions
@@ -754,11 +858,12 @@ SemanticChecker::Value SemanticChecker::operator()(ast::DefaultArgExpr &node) {
 }
 
 void SemanticChecker::class_first_pass(ast::ClassDef &node) {
-    string class_name = node.head->name;
+    cpm::Symbol class_name = node.head->name;
     if (classes.contains(class_name))
-        error("class " + class_name + " has already been declared", node);
+        error("class " + class_name.str() + " has already been declared", node);
     defined_class = class_name;
     classes[defined_class] = make_unique<Class>(current_scope);
+    shared->class_orders[defined_class] = declaration_order();
     current_scope = classes[defined_class].get();
 
     // set up starting access
@@ -783,16 +888,18 @@ void SemanticChecker::class_first_pass(ast::MemberSpecification &node) {
         if (ast::AccessModifier *am = get_if<ast::AccessModifier>(ms.get()))
             current_access = *am;
         else if (ast::MemberDeclaration *md = get_if<ast::MemberDeclaration>(ms.get())) {
-            pair<ast::FuncDef *, ast::AccessModifier> poss_method = class_first_pass(*md);
-            if (poss_method.first != nullptr)
-                methods.push_back(poss_method);
+            recover([&] {
+                pair<ast::FuncDef *, ast::AccessModifier> poss_method = class_first_pass(*md);
+                if (poss_method.first != nullptr)
+                    methods.push_back(poss_method);
+            });
         } else
             assert(false);
     }
     // process the methods
     for (const auto &[func_def, am]: methods) {
         current_access = am;
-        class_first_pass(*func_def);
+        recover([&] { class_first_pass(*func_def); });
     }
 }
 
@@ -817,17 +924,29 @@ void SemanticChecker::class_first_pass(ast::MemberDeclarator &node) {
     // this assumes that functions are handled separately, so function overloading won't
     // trigger this
     assert(!cpm::function_ty(node.type));
-    if (classes[defined_class]->contains(node.id))
-        error("name '" + node.id + "' already exists in class scope", node);
+    if (classes.at(defined_class)->contains(node.id))
+        error("name '" + node.id.str() + "' already exists in class scope", node);
 
     // for class fields, the class type itself is incomplete
     cpm::SimpleType *class_type = getSimpleType(defined_class, false);
     incomplete_types.insert(class_type);
-    process(node);
+    // pointer arithmetic on the class type is checked differently now
+    bin_op_cache.clear();
+    try {
+        process(node);
+    }
+    catch (const SemanticError &) {
+        // the class must not stay incomplete when the analysis recovers
+        incomplete_types.erase(class_type);
+        bin_op_cache.clear();
+        throw;
+    }
     incomplete_types.erase(class_type);
+    bin_op_cache.clear();
 
     // add the field to class scope
-    classes[defined_class]->addValue(node.id, node.type, &node, current_access);
+    classes.at(defined_class)->addField(node.id, node.type, &node, current_access,
+                                        declaration_order());
 }
 
 void SemanticChecker::class_first_pass(ast::FuncDef &node) {
@@ -845,22 +964,26 @@ SemanticChecker::Value SemanticChecker::operator()(ast::MemberAccessExpr &node)
     else if (!node.ptr_access && val.valtype == RValue)
         error("member access of " + val.str(), node);
 
-    string class_name = class_type->getTypeId();
-    string member_name = node.member;
-    assert(classes.contains(class_name));
-    Class *class_scope = classes[class_name].get();
+    cpm::Symbol class_name = class_type->getTypeId();
+    cpm::Symbol member_name = node.member;
+    Class *class_scope = find_class(class_name);
+    assert(class_scope);
     if (!class_scope->contains(member_name))
-        error("member access to unknown member '" + node.member + "'", node);
-    vector<ScopeValue> vals = class_scope->getValues(member_name, false);
+        error("member access to unknown member '" + node.member.str() + "'", node);
+    std::span<const ScopeValue> vals = class_scope->getValues(member_name, false);
     assert(!vals.empty());
     // check that this is not a function
-    if (cpm::function_ty(vals.at(0).type))
+    if (cpm::function_ty(vals[0].type))
         error("member function accessed in a different context than call", node);
 
     // limit private access outside the class
     if (!inside_scope(class_scope))
         if (class_scope->is_private(vals[0].decl))
-            error("cannot access private member '" + member_name + "'", node);
+            error("cannot access private member '" + member_name.str() + "'", node);
+
+    // resolve the field here, so that codegen doesn't have to look it up by name
+    node.field_index = class_scope->getFieldIndex(vals[0].decl);
+    assert(node.field_index.has_value());
 
     if (class_type->isConst())
         return {const_type(vals[0].type), LValue};
@@ -885,7 +1008,7 @@ void SemanticChecker::class_second_pass(ast::MemberSpecification &node) {
         if (ast::AccessModifier *am = get_if<ast::AccessModifier>(ms.get()))
             current_access = *am;
         else if (ast::MemberDeclaration *md = get_if<ast::MemberDeclaration>(ms.get()))
-            class_second_pass(*md);
+            recover([&] { class_second_pass(*md); });
         else
             assert(false);
     }
@@ -914,7 +1037,7 @@ void SemanticChecker::operator()(ast::ClassDef &node) {
 
     // reset values
     current_scope = parent;
-    defined_class = "";
+    defined_class = {};
 }
 
 SemanticChecker::Value SemanticChecker::operator()(ast::ThisExpr &node) {
@@ -954,6 +1077,21 @@ cpm::Type *SemanticChecker::const_type(cpm::Type *type) {
 // refactor: make a struct of the three types, and make the return of this std::optional
 std::tuple<cpm::Type *, cpm::Type *, cpm::Type *>
 SemanticChecker::conversions_for_bin_op(cpm::Type *lhs, cpm::Type *rhs, ast::BinaryOp op) {
+    bin_op_queries++;
+    BinOpKey key{lhs, rhs, op};
+    auto it = bin_op_cache.find(key);
+    if (it != bin_op_cache.end()) {
+        bin_op_cache_hits++;
+        return it->second;
+    }
+    // computing may check implicit conversions, but never touches bin_op_cache
+    auto res = compute_bin_op_conversions(lhs, rhs, op);
+    bin_op_cache.emplace(key, res);
+    return res;
+}
+
+std::tuple<cpm::Type *, cpm::Type *, cpm::Type *>
+SemanticChecker::compute_bin_op_conversions(cpm::Type *lhs, cpm::Type *rhs, ast::BinaryOp op) {
     cpm::Type *bool_ty = getBoolType();
     cpm::Type *int_ty = getIntType();
     cpm::Type *common_type = determine_common_type(lhs, rhs);
@@ -995,14 +1133,161 @@ SemanticChecker::Value SemanticChecker::operator()(ast::ImplicitTypeCastExpr &no
     return {node.dest_ty, RValue};
 }
 
+SemanticChecker::Value SemanticChecker::operator()(ast::ConstantExpr &node) {
+    // the expression has already been checked when it was folded
+    switch (node.value.type) {
+        case cpm::SimpleType::Builtin::Int:
+            return {getIntType(), RValue};
+        case cpm::SimpleType::Builtin::Char:
+            return {getCharType(), RValue};
+        case cpm::SimpleType::Builtin::Bool:
+            return {getBoolType(), RValue};
+        case cpm::SimpleType::Builtin::Double:
+            return {getDoubleType(), RValue};
+        default:
+            compiler_error("unexpected type of a constant expression", node);
+    }
+}
+
 SemanticChecker::Value SemanticChecker::operator()(ast::LValToRValExpr &node) {
     Value val = process(node.val);
     assert(val.valtype == LValue);
     return {val.type, RValue};
 }
 
+SemanticChecker::SemanticChecker(const SemanticChecker &main, std::ostream &warning_os) :
+        context(main.context),
+        warning_os(warning_os),
+        max_errors(main.max_errors),
+        threads(1),
+        shared(main.shared),
+        global_scope(main.global_scope),
+        valid_types_cache(main.valid_types_cache),
+        incomplete_types(main.incomplete_types) {}
+
 void SemanticChecker::run(ast::TranslationUnit &node) {
-    process(node);
+    // nodes added by the semantic analysis live in the arena of the translation unit
+    if (!node.arena)
+        node.arena = std::make_unique<ast::Arena>();
+    ast::Arena::Scope arena_scope(*node.arena);
+    shared->stop_at_max_errors = threads <= 1;
+    bool too_many_errors = false;
+    try {
+        // with more threads, the function bodies are only collected here
+        process(node);
+        if (!deferred_bodies.empty())
+            check_deferred_bodies(node);
+    }
+    catch (const SemanticError &) {
+        // only errors over the limit get here, the others are recovered from
+        too_many_errors = true;
+    }
+    flush_statistics();
+    // like one thread, which stops once it reaches the limit
+    if (!shared->stop_at_max_errors && max_errors != 0 && errors.size() >= max_errors)
+        too_many_errors = true;
+
+    if (errors.empty()) {
+        // the call graph is complete only after all the bodies are checked
+        EffectsAnalysis().run(node);
+        return;
+    }
+    std::stable_sort(errors.begin(), errors.end(), [](const Error &e1, const Error &e2) {
+        return std::tie(e1.line_no, e1.col_no) < std::tie(e2.line_no, e2.col_no);
+    });
+    // only the first ones are reported when the bodies are checked in parallel
+    if (max_errors != 0 && errors.size() > max_errors)
+        errors.resize(max_errors);
+    string msg;
+    for (const Error &e: errors) {
+        if (!msg.empty())
+            msg += '\n';
+        msg += e.msg;
+    }
+    if (too_many_errors)
+        msg += "\ntoo many errors, stopping after " + std::to_string(max_errors);
+    throw std::runtime_error(msg);
+}
+
+std::vector<std::string> SemanticChecker::getErrors() const {
+    std::vector<std::string> res;
+    for (const Error &e: errors)
+        res.push_back(e.msg);
+    return res;
+}
+
+void SemanticChecker::check_deferred_bodies(ast::TranslationUnit &tu) {
+    const size_t num_workers = std::min<size_t>(threads, deferred_bodies.size());
+    std::vector<std::unique_ptr<SemanticChecker>> workers;
+    std::vector<std::ostringstream> warnings(num_workers);
+    // ast arenas are per thread, the nodes are handed over to the translation unit afterwards
+    std::vector<std::unique_ptr<ast::Arena>> arenas;
+    for (size_t w = 0; w < num_workers; w++) {
+        workers.emplace_back(new SemanticChecker(*this, warnings[w]));
+        arenas.push_back(std::make_unique<ast::Arena>());
+    }
+
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> stop = false;
+    std::vector<std::exception_ptr> failures(num_workers);
+    auto work = [&](size_t w) {
+        ast::Arena::Scope arena_scope(*arenas[w]);
+        try {
+            for (size_t i; !stop && (i = next++) < deferred_bodies.size();)
+                workers[w]->check_body(deferred_bodies[i]);
+        }
+        catch (...) {
+            // the checker failed, the errors in the code are recovered from
+            failures[w] = std::current_exception();
+            stop = true;
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t w = 1; w < num_workers; w++)
+        pool.emplace_back(work, w);
+    work(0);
+    for (std::thread &t: pool)
+        t.join();
+
+    for (size_t w = 0; w < num_workers; w++) {
+        tu.arena->absorb(*arenas[w]);
+        std::move(workers[w]->errors.begin(), workers[w]->errors.end(), std::back_inserter(errors));
+        workers[w]->flush_statistics();
+        warning_os << warnings[w].str();
+    }
+    deferred_bodies.clear();
+    for (const std::exception_ptr &failure: failures)
+        if (failure)
+            std::rethrow_exception(failure);
+}
+
+void SemanticChecker::check_body(const DeferredBody &body) {
+    // the same state as if the body was checked in place, see operator()(ast::FuncDef &)
+    current_scope = body.scope;
+    defined_class = body.defined_class;
+    curr_ret_type = body.ret_type;
+    visible_before = body.visible_before;
+    loop_level = 0;
+    cs_new_scope = false;
+    recover([&] { process(*body.func_def->body); });
+    cs_new_scope = true;
+}
+
+void SemanticChecker::flush_statistics() {
+    num_conversion_queries += conversion_queries;
+    num_conversion_cache_hits += conversion_cache_hits;
+    num_bin_op_queries += bin_op_queries;
+    num_bin_op_cache_hits += bin_op_cache_hits;
+    num_folded_exprs += folded_exprs;
+    conversion_queries = conversion_cache_hits = bin_op_queries = bin_op_cache_hits = 0;
+    folded_exprs = 0;
+}
+
+Class *SemanticChecker::find_class(cpm::Symbol name) const {
+    auto it = classes.find(name);
+    if (it == classes.end() || shared->class_orders.at(name) >= visible_before)
+        return nullptr;
+    return it->second.get();
 }
 
 Scope *SemanticChecker::addScope(Scope *scope) {
@@ -1022,19 +1307,28 @@ void SemanticChecker::dropScope() {
 
 void SemanticChecker::error(const string &msg, const ast::Node &node) {
     string resp = "line " + node.src_info.str() + ": error: " + msg;
-    resp += '\n' + context.getInputByLines().at(node.src_info.line_no);
-    throw std::runtime_error(resp);
+    resp += '\n';
+    resp += context.getLine(node.src_info.line_no);
+    report(std::move(resp), node);
 }
 
 void SemanticChecker::compiler_error(const string &msg, const ast::Node &node) {
     string resp = "line " + node.src_info.str() + ": compiler error: " + msg;
-    resp += '\n' + context.getInputByLines().at(node.src_info.line_no);
-    throw std::runtime_error(resp);
+    resp += '\n';
+    resp += context.getLine(node.src_info.line_no);
+    report(std::move(resp), node);
+}
+
+void SemanticChecker::report(std::string msg, const ast::Node &node) {
+    errors.push_back({node.src_info.line_no, node.src_info.col_no, msg});
+    ++shared->num_errors;
+    throw SemanticError(msg);
 }
 
 void SemanticChecker::warning(const string &msg, const ast::Node &node) {
     string resp = "line " + node.src_info.str() + ": warning: " + msg;
-    resp += '\n' + context.getInputByLines().at(node.src_info.line_no);
+    resp += '\n';
+    resp += context.getLine(node.src_info.line_no);
     warning_os << resp << '\n';
 }
 
@@ -1053,12 +1347,11 @@ cpm::SimpleType *SemanticChecker::common_type(cpm::SimpleType *s1, cpm::SimpleTy
 
     // this should be true after all the previous checks
     assert(is_integral(s1) && is_integral(s2));
-    const std::string &str1 = s1->getTypeId(), &str2 = s2->getTypeId();
-    if (str1 == "int" || str2 == "int")
+    if (is_int(s1) || is_int(s2))
         return getIntType();
-    else if (str1 == "char" || str2 == "char")
+    else if (is_char(s1) || is_char(s2))
         return getCharType();
-    else if (str1 == "bool" || str2 == "bool")
+    else if (is_bool(s1) || is_bool(s2))
         return getBoolType();
 
     assert(false && "unexpected integral types");
@@ -1138,7 +1431,7 @@ SemanticChecker::get_underlying_type(SemanticChecker::Value val, bool ptr_access
         underlying_type = val.type;
 
     cpm::SimpleType *s = cpm::simple_ty(underlying_type);
-    if (!s || !classes.contains(s->getTypeId()))
+    if (!s || !find_class(s->getTypeId()))
         error("accessed object is not of class or struct type: " + cpm::to_string(underlying_type),
               node);
 
@@ -1170,6 +1463,8 @@ SemanticChecker::convert_to_rval(ast::node_ptr<ast::Expr> val, Value from, cpm::
     else if (cpm::pointer_ty(from.type) || cpm::simple_ty(from.type)) {
         rval = ast::make_node<ast::LValToRValExpr, ast::Expr>(node.src_info, std::move(val));
         rval_ty = const_unqualified_type(from.type);
+        // reading a const variable
+        fold(rval, rval_ty);
     }
     // note: array to ptr decay already took place when 'val' was visited
     else
@@ -1180,14 +1475,35 @@ SemanticChecker::convert_to_rval(ast::node_ptr<ast::Expr> val, Value from, cpm::
     switch (am) {
         case EXACT:
         case CONST:
-            return rval;
+            break;
         case CONVERSION:
-            return ast::make_node<ast::ImplicitTypeCastExpr, ast::Expr>(node.src_info,
+            rval = ast::make_node<ast::ImplicitTypeCastExpr, ast::Expr>(node.src_info,
                                                                         std::move(rval), dest);
+            break;
         case NONE:
         default:
             return convert_error(from, dest, node, throw_error);
     }
+    fold(rval, dest);
+    return rval;
+}
+
+void SemanticChecker::fold(ast::node_ptr<ast::Expr> &node_ptr, cpm::Type *type) {
+    std::optional<cpm::SimpleType::Builtin> builtin = ast::ConstExprEvaluator::arithmetic_type(type);
+    // literals are constants already
+    if (!builtin || holds_alternative<ast::ConstantExpr>(*node_ptr) ||
+        holds_alternative<ast::IntLiteral>(*node_ptr) ||
+        holds_alternative<ast::CharLiteral>(*node_ptr) ||
+        holds_alternative<ast::BoolLiteral>(*node_ptr) ||
+        holds_alternative<ast::FloatLiteral>(*node_ptr))
+        return;
+    std::optional<ast::ConstValue> value = ast::ConstExprEvaluator(true)(*node_ptr);
+    if (!value || value->type != *builtin)
+        return;
+    ast::SourceInfo src_info = std::visit([](const auto &n) { return n.src_info; }, *node_ptr);
+    node_ptr = ast::make_node<ast::ConstantExpr, ast::Expr>(src_info, std::move(node_ptr),
+                                                            *value);
+    folded_exprs++;
 }
 
 cpm::Type *SemanticChecker::const_unqualified_type(cpm::Type *t) {
@@ -1239,8 +1555,8 @@ SemanticChecker::operator()(ast::node_ptr<ast::Expr> &node_ptr, bool array_to_pt
     if (id_expr)
         if (refers_to_class_member(id_expr->id)) {
             // check if a member is used in default argument
-            if (current_scope == classes[defined_class].get())
-                error("cannot use non-static member '" + id_expr->id + "' here", *id_expr);
+            if (current_scope == classes.at(defined_class).get())
+                error("cannot use non-static member '" + id_expr->id.str() + "' here", *id_expr);
             // replace the original expression with ImplicitThis access
             *replaced_expr = ast::make_node<ast::MemberAccessExpr, ast::Expr>(
                     id_expr->src_info,
@@ -1278,14 +1594,18 @@ SemanticChecker::operator()(ast::node_ptr<ast::Expr> &node_ptr, bool array_to_pt
         }
     }
 
+    // the operands are folded first, so an expression only has to look at its operands
+    if (val.valtype == RValue)
+        fold(node_ptr, val.type);
+
     return val;
 }
 
-bool SemanticChecker::refers_to_class_member(const std::string &id) {
+bool SemanticChecker::refers_to_class_member(cpm::Symbol id) {
     return !defined_class.empty() &&
            // constructors are not considered members
            id != defined_class &&
-           classes[defined_class].get() == current_scope->getValueScope(id);
+           classes.at(defined_class).get() == current_scope->getValueScope(id, visible_before);
 }
 
 SemanticChecker::Value SemanticChecker::operator()(ast::CastExpr &node) {
@@ -1339,7 +1659,7 @@ void SemanticChecker::add_this_to_func_decl(ast::FunctionDecl *func_decl) {
     ast::node_ptr<ast::Param> this_param = ast::make_node<ast::Param>(
             func_decl->src_info,
             // important: LLBuilder depends on the name being "this"
-            ast::make_node<ast::Decl>(func_decl->src_info, this_type, "this"),
+            ast::make_node<ast::Decl>(func_decl->src_info, this_type, context.intern("this")),
             std::nullopt);
     func_decl->params.insert(func_decl->params.begin(), std::move(this_param));
 }
@@ -1353,7 +1673,7 @@ void SemanticChecker::operator()(ast::Decl &node) {
     //       will have to be replicated where it's needed (function
     //       variables, class members, ...?).
     if (incomplete_type(node.type))
-        error("declarator '" + node.id + "' has incomplete type: " +
+        error("declarator '" + node.id.str() + "' has incomplete type: " +
               to_string(node.type), node);
 }
 
@@ -1361,7 +1681,7 @@ void SemanticChecker::validate_type(cpm::Type *type, const ast::Node &node) {
     if (valid_types_cache.contains(type))
         return;
     else if (auto *st = simple_ty(type)) {
-        if (!type_exists(st->getTypeId()))
+        if (!type_exists(st))
             error("unknown type: " + to_string(st), node);
     } else if (auto *pt = pointer_ty(type)) {
         cpm::Type *elem_type = pt->getElemType();
@@ -1426,7 +1746,7 @@ bool SemanticChecker::is_floating(cpm::Type *type) {
 }
 
 bool SemanticChecker::is_floating(cpm::SimpleType *simple_ty) {
-    return simple_ty && simple_ty->getTypeId() == "double";
+    return simple_ty && simple_ty->isBuiltin(SimpleType::Builtin::Double);
 }
 
 cpm::SimpleType *SemanticChecker::getDoubleType(bool is_const) {
@@ -1545,7 +1865,7 @@ void SemanticChecker::add_builtin_functions(ast::TranslationUnit &tu) {
 }
 
 ast::node_ptr<ast::Declaration>
-SemanticChecker::create_func_declaration_node(const string &func_name, cpm::Type *ret_type,
+SemanticChecker::create_func_declaration_node(std::string_view func_name, cpm::Type *ret_type,
                                               std::vector<ast::node_ptr<ast::Param>> params,
                                               bool is_vararg) {
     ast::SourceInfo src_info;
@@ -1559,9 +1879,11 @@ SemanticChecker::create_func_declaration_node(const string &func_name, cpm::Type
     auto func_decl = ast::make_node<ast::FunctionDecl>(
             src_info,
             func_type,
-            func_name,
+            context.intern(func_name),
             std::move(params)
     );
+    // the c library doesn't call back into the program
+    func_decl->norecurse = true;
     // get init declarator list
     vector<ast::node_ptr<ast::InitDeclarator>> init_declars;
     init_declars.push_back(
@@ -1578,7 +1900,7 @@ SemanticChecker::create_func_declaration_node(const string &func_name, cpm::Type
     );
 }
 
-ast::node_ptr<ast::Param> SemanticChecker::make_param(Type *type, const std::string &name,
+ast::node_ptr<ast::Param> SemanticChecker::make_param(Type *type, std::string_view name,
                                                       std::optional<ast::node_ptr<ast::Expr>> def_val,
                                                       const ast::SourceInfo &src_info) {
     return ast::make_node<ast::Param>(
@@ -1586,7 +1908,7 @@ ast::node_ptr<ast::Param> SemanticChecker::make_param(Type *type, const std::str
             ast::make_node<ast::Decl>(
                     src_info,
                     type,
-                    name
+                    context.intern(name)
             ),
             std::move(def_val)
     );
@@ -1600,14 +1922,14 @@ void SemanticChecker::operator()(ast::FunctionDecl &node, const bool process_def
     process(dynamic_cast<ast::Decl &>(node));
     // check for parameter validity, name collisions and gaps in default arguments
     bool def_args_started = false;
-    set<string> param_names;
+    unordered_set<cpm::Symbol, cpm::SymbolHash> param_names;
     for (const auto &p: node.params) {
         // param validity
         process(*p->declarator);
         // params name collision
-        const auto &p_name = p->declarator->id;
+        cpm::Symbol p_name = p->declarator->id;
         if (param_names.contains(p_name))
-            error("repeated parameter name: '" + p_name + "'", node);
+            error("repeated parameter name: '" + p_name.str() + "'", node);
         param_names.insert(p_name);
         // default arg gap
         if (def_args_started && !p->default_val.has_value())
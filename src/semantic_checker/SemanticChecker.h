@@ -1,9 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <set>
+#include <string_view>
 #include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "utils/Context.h"
 #include "semantic_checker/scope/Scope.h"
@@ -22,18 +30,47 @@ namespace cpm::sc {
  * */
     class SemanticChecker {
     public:
+        /**
+         * @param max_errors  stop the analysis after this many errors, 0 for no limit
+         * @param threads  number of threads that check the function bodies, see run()
+         */
         SemanticChecker(cpm::Context &context,
-                        std::ostream &warning_os) :
+                        std::ostream &warning_os,
+                        size_t max_errors = 20,
+                        unsigned threads = 1) :
                 context(context),
-                warning_os(warning_os) {}
+                warning_os(warning_os),
+                max_errors(max_errors),
+                threads(threads) {}
 
         /**
          * Run the checker on AST.
          *
+         * An error abandons only the statement, declaration or class member it's in,
+         * the analysis goes on with the next one. If there were any errors, an
+         * 'std::runtime_error' with all of them is thrown at the end.
+         *
+         * With more than one thread, the analysis has two phases. The declarations
+         * (globals, functions, classes and their members) are checked sequentially
+         * first, then the function bodies are checked in parallel, each one by a worker
+         * with its own scopes. A body only sees what is declared before it, as
+         * if it was checked in place. The errors are sorted by line in both cases.
+         * A translation unit without errors is then given to EffectsAnalysis.
+         *
+         * One thread stops at 'max_errors' errors. Which errors the workers would find
+         * before stopping depends on the timing, so with more threads all the bodies
+         * are checked and the first 'max_errors' errors are kept, the same ones as
+         * with one thread.
+         *
          * Should only be called once, UB if it is called multiple times.
          */
         void run(ast::TranslationUnit &node);
 
+        /**
+         * The errors found by run(), in the order of the lines they're on.
+         */
+        std::vector<std::string> getErrors() const;
+
         enum ValueType {
             LValue,
             RValue
@@ -125,6 +162,8 @@ namespace cpm::sc {
 
         Value operator()(ast::ArrToPtrExpr &);
 
+        Value operator()(ast::ConstantExpr &);
+
         /* statements */
         void operator()(ast::Stmt &);
 
@@ -223,6 +262,48 @@ namespace cpm::sc {
         void operator()(ast::TranslationUnit &);
 
     private:
+        /**
+         * Create a worker that checks the deferred function bodies of 'main'.
+         */
+        SemanticChecker(const SemanticChecker &main, std::ostream &warning_os);
+
+        /**
+         * A function body that's checked after all declarations, see run().
+         */
+        struct DeferredBody {
+            ast::FuncDef *func_def;
+            // scope of the parameters
+            Scope *scope;
+            cpm::Symbol defined_class;
+            cpm::Type *ret_type;
+            // only values declared before the function are visible in the body
+            size_t visible_before;
+        };
+
+        /**
+         * Check the deferred function bodies on 'threads' threads.
+         */
+        void check_deferred_bodies(ast::TranslationUnit &tu);
+
+        void check_body(const DeferredBody &body);
+
+        /**
+         * Add the counters of the caches to the statistics.
+         */
+        void flush_statistics();
+
+        /**
+         * @return order for a value that's being added to a scope, see ScopeValue::order
+         */
+        size_t declaration_order() {
+            // everything a deferred body declares is local, it's visible where it's declared
+            return visible_before == SIZE_MAX ? next_order++ : 0;
+        }
+
+        /**
+         * @return the class, or nullptr if it doesn't exist or isn't visible yet
+         */
+        Class *find_class(cpm::Symbol name) const;
 
         /**
          * Processes 'val' and tries to convert it to rvalue of given type.
@@ -298,7 +379,7 @@ namespace cpm::sc {
         static bool is_void(cpm::SimpleType *simple_ty);
 
         static bool is_int(cpm::SimpleType *simple_ty) {
-            return simple_ty && simple_ty->getTypeId() == "int";
+            return simple_ty && simple_ty->isBuiltin(cpm::SimpleType::Builtin::Int);
         }
 
         static bool is_int(cpm::Type *type) {
@@ -306,19 +387,19 @@ namespace cpm::sc {
         }
 
         static bool is_double(cpm::SimpleType *simple_ty) {
-            return simple_ty && simple_ty->getTypeId() == "double";
+            return simple_ty && simple_ty->isBuiltin(cpm::SimpleType::Builtin::Double);
         }
 
         static bool is_bool(cpm::SimpleType *simple_ty) {
-            return simple_ty && simple_ty->getTypeId() == "bool";
+            return simple_ty && simple_ty->isBuiltin(cpm::SimpleType::Builtin::Bool);
         }
 
         static bool is_char(cpm::SimpleType *simple_ty) {
-            return simple_ty && simple_ty->getTypeId() == "char";
+            return simple_ty && simple_ty->isBuiltin(cpm::SimpleType::Builtin::Char);
         }
 
         static bool is_nullptr(cpm::SimpleType *simple_ty) {
-            return simple_ty && simple_ty->getTypeId() == "nullptr_t";
+            return simple_ty && simple_ty->isBuiltin(cpm::SimpleType::Builtin::Nullptr);
         }
 
         static bool is_nullptr(cpm::Type *type) {
@@ -326,19 +407,28 @@ namespace cpm::sc {
         }
 
         /**
-         * Checks whether a SimpleType with given name exists and is accessible to the user.
+         * Checks whether a SimpleType exists and is accessible to the user.
          */
-        bool type_exists(const std::string &type_id);
+        bool type_exists(const cpm::SimpleType *type);
 
         /**
-         * Throws an 'std::runtime_error' exception with the error.
+         * Thrown by error() after the error is recorded, to abandon the checking
+         * of the current statement or declaration, see recover().
+         */
+        class SemanticError : public std::runtime_error {
+        public:
+            using std::runtime_error::runtime_error;
+        };
+
+        /**
+         * Records the error and throws SemanticError.
          * @param msg
          * @param node
          */
         [[noreturn]] void error(const std::string &msg, const ast::Node &node);
 
         /**
-         * Throws an 'std::runtime_error' exception with the error.
+         * Records the error and throws SemanticError.
          * Used to report unimplemented functionality that the user might expect to work.
          * Otherwise is the same as error().
          * @param msg
@@ -346,11 +436,30 @@ namespace cpm::sc {
          */
         [[noreturn]] void compiler_error(const std::string &msg, const ast::Node &node);
 
+        /**
+         * Record the error and throw SemanticError.
+         */
+        [[noreturn]] void report(std::string msg, const ast::Node &node);
+
+        /**
+         * Run 'check' (checking of a statement, declaration..), and recover if it fails
+         * with an error - the state (current scope, loop level..) is restored, so
+         * that the analysis can go on with the next one.
+         *
+         * The error is passed on if there are already max_errors errors.
+         */
+        template<typename Check>
+        void recover(Check &&check);
+
         /* Reports warnings about the source code. */
         void warning(const std::string &msg, const ast::Node &node);
 
         /* factories for types */
-        cpm::SimpleType *getSimpleType(const std::string &type_id, bool is_const) {
+        cpm::SimpleType *getSimpleType(cpm::Symbol type_id, bool is_const) {
+            return context.getSimpleType(type_id, is_const);
+        }
+
+        cpm::SimpleType *getSimpleType(std::string_view type_id, bool is_const) {
             return context.getSimpleType(type_id, is_const);
         }
 
@@ -437,12 +546,31 @@ namespace cpm::sc {
         std::tuple<cpm::Type *, cpm::Type *, cpm::Type *>
         conversions_for_bin_op(cpm::Type *lhs, cpm::Type *rhs, ast::BinaryOp op);
 
+        /**
+         * Uncached part of conversions_for_bin_op.
+         */
+        std::tuple<cpm::Type *, cpm::Type *, cpm::Type *>
+        compute_bin_op_conversions(cpm::Type *lhs, cpm::Type *rhs, ast::BinaryOp op);
+
         /**
          * Returns true if expression of type 't' is viable for the '++' or '--' operator
          * (in either the preincrement or the postincrement form, doesn't matter).
          */
         bool viable_incr_type(cpm::Type *t);
 
+        /**
+         * Mark the local variable designated by an lvalue expression as address taken,
+         * see ast::Decl::address_taken. Looks through the expressions that result in
+         * their operand's lvalue, e.g. 'a = b' or '++a'.
+         */
+        void mark_address_taken(const ast::Expr &lvalue);
+
+        /**
+         * If the value of an rvalue expression of type 'type' is known at compile time,
+         * wrap the expression in ast::ConstantExpr, see ast::ConstExprEvaluator.
+         */
+        void fold(ast::node_ptr<ast::Expr> &node_ptr, cpm::Type *type);
+
         /**
          * Gets the class type of the object that is being accessed
          * either directly or indirectly threw pointer.
@@ -529,7 +657,7 @@ namespace cpm::sc {
          * @param node  used for error reporting
          * @return
          */
-        ScopeValue resolveCallOverload(const std::string &func_name, Scope *scope,
+        ScopeValue resolveCallOverload(cpm::Symbol func_name, Scope *scope,
                                        const std::vector<cpm::Type *> &arg_types,
                                        const ast::CallExpr &node);
 
@@ -557,6 +685,11 @@ namespace cpm::sc {
          */
         TypeMatch implicitly_convertible(cpm::Type *start, cpm::Type *dest);
 
+        /**
+         * Uncached part of implicitly_convertible.
+         */
+        TypeMatch compute_implicit_conversion(cpm::Type *start, cpm::Type *dest);
+
         /**
          * Checks if rvalue of type 'start_ty' can be converted to rvalue of type
          * 'dest_ty'.
@@ -597,7 +730,7 @@ namespace cpm::sc {
          * @param id
          * @return
          */
-        bool refers_to_class_member(const std::string &id);
+        bool refers_to_class_member(cpm::Symbol id);
 
         /**
          * Check if the type is incomplete.
@@ -646,7 +779,7 @@ namespace cpm::sc {
          * Create ast node that corresponds to forward declaration of a function.
          */
         ast::node_ptr<ast::Declaration> create_func_declaration_node(
-                const std::string &func_name, Type *ret_type,
+                std::string_view func_name, Type *ret_type,
                 std::vector<ast::node_ptr<ast::Param>> params,
                 bool is_vararg
         );
@@ -654,7 +787,7 @@ namespace cpm::sc {
         /**
          * Create an ast::Param node.
          */
-        ast::node_ptr<ast::Param> make_param(Type *type, const std::string &name,
+        ast::node_ptr<ast::Param> make_param(Type *type, std::string_view name,
                                              std::optional<ast::node_ptr<ast::Expr>> def_val = std::nullopt,
                                              const ast::SourceInfo &src_info = ast::SourceInfo());
 
@@ -676,6 +809,39 @@ namespace cpm::sc {
 
         cpm::Context &context;
         std::ostream &warning_os;
+        size_t max_errors;
+        unsigned threads;
+
+        struct Error {
+            // the position orders the errors, the bodies checked in parallel
+            // can be on the same line
+            size_t line_no;
+            size_t col_no;
+            std::string msg;
+        };
+        // errors found by this checker
+        std::vector<Error> errors;
+
+        /**
+         * The state shared by the main checker and its workers.
+         *
+         * The declarations are only added by the main checker before the workers start,
+         * the workers only read them.
+         */
+        struct Shared {
+            // user defined classes (scopes)
+            std::unordered_map<cpm::Symbol, std::unique_ptr<Class>, cpm::SymbolHash> classes;
+            // order of the class declarations, see ScopeValue::order
+            std::unordered_map<cpm::Symbol, size_t, cpm::SymbolHash> class_orders;
+            std::map<const ast::Decl *, std::vector<ast::Expr *>> funcs_def_args;
+            std::map<const ast::Expr *, Value> def_arg_vals;
+            std::set<const ast::Decl *> defined_funcs;
+            // number of errors of all the checkers, for the max_errors limit
+            std::atomic<size_t> num_errors = 0;
+            // whether the analysis stops at max_errors, see run()
+            bool stop_at_max_errors = true;
+        };
+        std::shared_ptr<Shared> shared = std::make_shared<Shared>();
 
         /**
         * This flag indicates whether the next CompoundStmt should
@@ -690,7 +856,7 @@ namespace cpm::sc {
         // non class scopes
         std::vector<std::unique_ptr<Scope>> scopes;
         // user defined classes (scopes)
-        std::map<std::string, std::unique_ptr<Class>> classes;
+        std::unordered_map<cpm::Symbol, std::unique_ptr<Class>, cpm::SymbolHash> &classes = shared->classes;
         Scope *global_scope = nullptr;
         Scope *current_scope = nullptr;
         // return type of the function we're currently in, or nullptr if we're not inside a function
@@ -706,12 +872,12 @@ namespace cpm::sc {
          * If a function has multiple declarations, declarator of first one is used for the map key.
          */
         using DefArgList = std::vector<ast::Expr *>;
-        std::map<const ast::Decl *, DefArgList> funcs_def_args;
+        std::map<const ast::Decl *, DefArgList> &funcs_def_args = shared->funcs_def_args;
         /**
          * For each default value, save what was the Value result of visiting the expression.
          * This prevents revisiting the expression when 'process' is called on the ast::DefaultArgExpr
          */
-        std::map<const ast::Expr *, Value> def_arg_vals;
+        std::map<const ast::Expr *, Value> &def_arg_vals = shared->def_arg_vals;
 
 
         /**
@@ -719,15 +885,65 @@ namespace cpm::sc {
          * save here whether it has already been defined or not.
          * This is used to prevent function redefinitions.
          */
-        std::set<const ast::Decl *> defined_funcs;
+        std::set<const ast::Decl *> &defined_funcs = shared->defined_funcs;
 
         /**
-         * class that's being currently defined, "" for no class
+         * class that's being currently defined, empty symbol for no class
          */
-        std::string defined_class;
-        ast::AccessModifier current_access;
+        cpm::Symbol defined_class;
+        ast::AccessModifier current_access = ast::PUBLIC;
+
+        // order of the next declaration, see ScopeValue::order
+        size_t next_order = 1;
+        // values of this or higher order are not visible, limited while checking a deferred body
+        size_t visible_before = SIZE_MAX;
+        // bodies left for the parallel phase
+        std::vector<DeferredBody> deferred_bodies;
+
         // store valid types that have already been checked
         std::set<cpm::Type *> valid_types_cache;
+
+        // types are unique, so the conversions can be cached by the type pointers
+        struct TypePairHash {
+            size_t operator()(const std::pair<cpm::Type *, cpm::Type *> &types) const {
+                size_t h = std::hash<cpm::Type *>()(types.first);
+                // from boost::hash_combine
+                return h ^ (std::hash<cpm::Type *>()(types.second) + 0x9e3779b97f4a7c15ULL +
+                            (h << 6) + (h >> 2));
+            }
+        };
+
+        struct BinOpKey {
+            cpm::Type *lhs;
+            cpm::Type *rhs;
+            ast::BinaryOp op;
+
+            bool operator==(const BinOpKey &) const = default;
+        };
+
+        struct BinOpKeyHash {
+            size_t operator()(const BinOpKey &key) const {
+                return TypePairHash()({key.lhs, key.rhs}) * 31 + key.op;
+            }
+        };
+
+        // cache of implicitly_convertible, by (start, dest)
+        std::unordered_map<std::pair<cpm::Type *, cpm::Type *>, TypeMatch, TypePairHash> conversion_cache;
+        /**
+         * Cache of conversions_for_bin_op.
+         *
+         * The result depends on incomplete_types (pointer arithmetic), so the cache is
+         * cleared whenever incomplete_types changes.
+         */
+        std::unordered_map<BinOpKey, std::tuple<cpm::Type *, cpm::Type *, cpm::Type *>, BinOpKeyHash>
+                bin_op_cache;
+        // counters of the caches, added to the statistics at the end of run()
+        size_t conversion_queries = 0;
+        size_t conversion_cache_hits = 0;
+        size_t bin_op_queries = 0;
+        size_t bin_op_cache_hits = 0;
+        // counter of the expressions wrapped by fold(), added to the statistics too
+        size_t folded_exprs = 0;
         // contain const-unqualified versions of incomplete types
         std::set<cpm::Type *> incomplete_types = {
                 getVoidType()
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <optional>
 #include <utility>
 #include <set>
+#include <unordered_map>
 #include "ast/class/AccessModifier.h"
 
 #include "Scope.h"
@@ -15,19 +17,40 @@ namespace cpm::sc {
     class Class : public Scope {
         std::set<const ast::Decl *> public_members;
         std::set<const ast::Decl *> private_members;
+        // index of each field in the order of declaration, methods are not fields
+        std::unordered_map<const ast::Decl *, unsigned> field_indices;
 
     public:
 
         explicit Class(Scope *parent) :
                 Scope(parent) {}
 
-        void addValue(const std::string &id, cpm::Type *type, const ast::Decl *decl,
-                      ast::AccessModifier am) {
+        void addValue(cpm::Symbol id, cpm::Type *type, const ast::Decl *decl,
+                      ast::AccessModifier am, size_t order = 0) {
             if (am == ast::PUBLIC)
                 public_members.emplace(decl);
             else if (am == ast::PRIVATE)
                 private_members.emplace(decl);
-            return Scope::addValue(id, type, decl);
+            return Scope::addValue(id, type, decl, order);
+        }
+
+        /**
+         * Add a field (not a method), the fields are indexed in the order they're added.
+         */
+        void addField(cpm::Symbol id, cpm::Type *type, const ast::Decl *decl,
+                      ast::AccessModifier am, size_t order = 0) {
+            field_indices.emplace(decl, field_indices.size());
+            addValue(id, type, decl, am, order);
+        }
+
+        /**
+         * Returns the index of a field, or nullopt if 'decl' is not a field of this class.
+         */
+        std::optional<unsigned> getFieldIndex(const ast::Decl *decl) const {
+            auto it = field_indices.find(decl);
+            if (it == field_indices.end())
+                return std::nullopt;
+            return it->second;
         }
 
         /**
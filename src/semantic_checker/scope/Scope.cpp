@@ -4,10 +4,10 @@
 using namespace std;
 using namespace cpm::sc;
 
-Scope *Scope::getValueScope(const std::string &id) {
+Scope *Scope::getValueScope(cpm::Symbol id, size_t visible_before) {
     Scope *scope = this;
     while (scope) {
-        if (scope->contains(id))
+        if (scope->contains(id, visible_before))
             break;
         scope = scope->parent;
     }
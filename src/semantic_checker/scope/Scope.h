@@ -1,12 +1,16 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
-#include <vector>
+#include <span>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "type/Type.h"
 #include "type/DerivedTypes.h"
 #include "ast/expr/DefaultArgExpr.h"
+#include "utils/Symbol.h"
 #include "ScopeValue.h"
 
 
@@ -17,7 +21,8 @@ namespace cpm::sc {
     class Scope {
     protected:
         Scope *parent;
-        std::map<std::string, std::vector<ScopeValue>> values;
+        // values under each id, there's more than one only for overloaded functions
+        std::unordered_map<cpm::Symbol, std::vector<ScopeValue>, cpm::SymbolHash> values;
         /* named subscopes */
         std::map<std::string, Scope *> named_children;
 
@@ -27,11 +32,24 @@ namespace cpm::sc {
 
         virtual ~Scope() = default;
 
-        std::vector<ScopeValue> getValues(const std::string &id, bool search_in_parent) {
-            if (contains(id))
-                return values[id];
-            else if (parent && search_in_parent)
-                return parent->getValues(id, search_in_parent);
+        /**
+         * Get the values declared under 'id' in the nearest scope that has any.
+         *
+         * Only the values with order below 'visible_before' are seen, so that a function
+         * body checked after the whole translation unit was declared (see SemanticChecker)
+         * doesn't see what is declared after it. Values are added in order, so the visible
+         * ones are always a prefix.
+         *
+         * The returned span is valid until a value with the same id is added to the scope.
+         * @param search_in_parent  look into the ancestor scopes too
+         */
+        std::span<const ScopeValue> getValues(cpm::Symbol id, bool search_in_parent,
+                                              size_t visible_before = SIZE_MAX) const {
+            for (const Scope *scope = this; scope; scope = search_in_parent ? scope->parent : nullptr) {
+                std::span<const ScopeValue> vals = scope->visible_values(id, visible_before);
+                if (!vals.empty())
+                    return vals;
+            }
             return {};
         }
 
@@ -39,9 +57,11 @@ namespace cpm::sc {
          *
          * @param id
          * @param type
+         * @param order  position of the declaration, must not be lower than the order
+         *               of the values already added under 'id'
          */
-        void addValue(const std::string &id, cpm::Type *type, const ast::Decl *decl) {
-            values[id].push_back({decl, type});
+        void addValue(cpm::Symbol id, cpm::Type *type, const ast::Decl *decl, size_t order = 0) {
+            values[id].push_back({decl, type, order});
         }
 
         /**
@@ -50,7 +70,7 @@ namespace cpm::sc {
          * @param id
          * @return
          */
-        Scope *getValueScope(const std::string &id);
+        Scope *getValueScope(cpm::Symbol id, size_t visible_before = SIZE_MAX);
 
         /**
          * Checks whether this scope contains a value with 'id'.
@@ -59,8 +79,8 @@ namespace cpm::sc {
          * @param id
          * @return
          */
-        bool contains(const std::string &id) {
-            return values.contains(id);
+        bool contains(cpm::Symbol id, size_t visible_before = SIZE_MAX) const {
+            return !visible_values(id, visible_before).empty();
         }
 
         [[nodiscard]] Scope *getParent() const {
@@ -70,5 +90,17 @@ namespace cpm::sc {
         void setParent(Scope *new_parent) {
             parent = new_parent;
         }
+
+    private:
+        std::span<const ScopeValue> visible_values(cpm::Symbol id, size_t visible_before) const {
+            auto it = values.find(id);
+            if (it == values.end())
+                return {};
+            const std::vector<ScopeValue> &vals = it->second;
+            size_t n = vals.size();
+            while (n > 0 && vals[n - 1].order >= visible_before)
+                n--;
+            return {vals.data(), n};
+        }
     };
 }
@@ -1,3 +1,5 @@
+#include <cstddef>
+
 #include "ast/decl/Decl.h"
 #include "type/Type.h"
 
@@ -10,6 +12,11 @@ namespace cpm::sc {
         const ast::Decl *decl;
         // type of the value
         Type *type;
+        /**
+         * Position of the declaration among the declarations of the translation unit,
+         * see Scope::getValues. Local variables don't need it, they're always 0.
+         */
+        size_t order = 0;
 
         // note on value category: since this is saved in a scope under a name, this is
         // always implicitly lvalue
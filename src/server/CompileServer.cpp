@@ -0,0 +1,461 @@
+#include "CompileServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace cpm::server {
+    namespace {
+        /*
+         * The protocol is a single request and a single response per connection.
+         * Numbers are sent in the host byte order, both sides run on the same machine.
+         *
+         * request:  u32 magic, u32 version, string body
+         * body:     u8 opt_level, u8 emit_kind, u8 flags, u32 max_errors, u32 sema_threads,
+         *           u32 codegen_threads, string source
+         * response: i32 exit_code, string out, string log, string err
+         * string:   u64 length, bytes
+         *
+         * The body is read whole before it's parsed, so that a request of another
+         * version can be answered instead of being misread. The response must keep its
+         * layout for that to work. A request the server doesn't handle (another version,
+         * too large, ...) is answered by exit code 'not_handled', the client then compiles
+         * the file by itself.
+         */
+        constexpr uint32_t protocol_magic = 0x534d5043; // "CPMS"
+        constexpr uint32_t protocol_version = 1;
+
+        // the body is allocated before it's read, the length sent by the peer can't be trusted;
+        // there's some room for the options besides the source
+        constexpr uint64_t max_body_size = max_source_size + 1024;
+
+        // not an exit code of the compiler, those are never negative
+        constexpr int32_t not_handled = -1;
+
+        enum Flags : uint8_t {
+            AstDumpRaw = 1,
+            AstDump = 2,
+            Time = 4,
+            DiscardValueNames = 8,
+            SsaLocals = 16,
+            WholeProgram = 32
+        };
+
+        [[noreturn]] void throw_errno(const std::string &what) {
+            throw std::system_error(errno, std::generic_category(), "CompileServer: " + what);
+        }
+
+        /**
+         * Wraps a connected socket, closes it when destroyed.
+         */
+        class Connection {
+        public:
+            explicit Connection(int fd) :
+                    fd(fd) {}
+
+            ~Connection() {
+                close(fd);
+            }
+
+            Connection(const Connection &) = delete;
+
+            Connection &operator=(const Connection &) = delete;
+
+            void write_bytes(const void *data, size_t size) {
+                const char *ptr = static_cast<const char *>(data);
+                while (size > 0) {
+                    // MSG_NOSIGNAL: don't get killed by SIGPIPE when the other side is gone
+                    ssize_t n = send(fd, ptr, size, MSG_NOSIGNAL);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                        throw std::runtime_error("CompileServer: send timed out");
+                    if (n <= 0)
+                        throw_errno("send failed");
+                    ptr += n;
+                    size -= n;
+                }
+            }
+
+            void read_bytes(void *data, size_t size) {
+                char *ptr = static_cast<char *>(data);
+                while (size > 0) {
+                    ssize_t n = recv(fd, ptr, size, 0);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                        throw std::runtime_error("CompileServer: recv timed out");
+                    if (n < 0)
+                        throw_errno("recv failed");
+                    if (n == 0)
+                        throw std::runtime_error("CompileServer: connection closed");
+                    ptr += n;
+                    size -= n;
+                }
+            }
+
+            template<typename T>
+            void write_num(T num) {
+                write_bytes(&num, sizeof(num));
+            }
+
+            template<typename T>
+            T read_num() {
+                T num;
+                read_bytes(&num, sizeof(num));
+                return num;
+            }
+
+            void write_str(const std::string &str) {
+                write_num<uint64_t>(str.size());
+                write_bytes(str.data(), str.size());
+            }
+
+            /**
+             * Throws std::length_error if the peer sends a string longer than 'max_size'.
+             */
+            std::string read_str(uint64_t max_size = std::numeric_limits<uint64_t>::max()) {
+                auto size = read_num<uint64_t>();
+                if (size > max_size)
+                    throw std::length_error("CompileServer: string of " + std::to_string(size) +
+                                            " bytes is too long");
+                std::string str(size, '\0');
+                read_bytes(str.data(), str.size());
+                return str;
+            }
+
+        private:
+            int fd;
+        };
+
+        /**
+         * Builds a request body in memory.
+         */
+        class Writer {
+        public:
+            template<typename T>
+            void write_num(T num) {
+                data.append(reinterpret_cast<const char *>(&num), sizeof(num));
+            }
+
+            void write_str(const std::string &str) {
+                write_num<uint64_t>(str.size());
+                data += str;
+            }
+
+            const std::string &getData() const {
+                return data;
+            }
+
+        private:
+            std::string data;
+        };
+
+        /**
+         * Parses a request body that has been read whole.
+         */
+        class Reader {
+        public:
+            explicit Reader(std::string_view data) :
+                    data(data) {}
+
+            template<typename T>
+            T read_num() {
+                T num;
+                std::memcpy(&num, take(sizeof(num)).data(), sizeof(num));
+                return num;
+            }
+
+            std::string read_str() {
+                auto size = read_num<uint64_t>();
+                return std::string(take(size));
+            }
+
+        private:
+            std::string_view data;
+
+            std::string_view take(size_t size) {
+                if (size > data.size())
+                    throw std::runtime_error("CompileServer: truncated request");
+                std::string_view res = data.substr(0, size);
+                data.remove_prefix(size);
+                return res;
+            }
+        };
+
+        /**
+         * Answer a request that the server doesn't compile, the client compiles the file
+         * by itself; 'msg' says why, for clients that don't know the status.
+         */
+        void reply_not_handled(Connection &conn, const std::string &msg) {
+            conn.write_num<int32_t>(not_handled);
+            conn.write_str("");
+            conn.write_str("");
+            conn.write_str("error: compile server: " + msg + "\n");
+        }
+
+        /**
+         * Number of threads that a request can use for one compilation step, a client
+         * can't make the server start more threads than there are cores.
+         */
+        uint32_t clamp_threads(uint32_t threads) {
+            return std::min(threads, std::max(1u, std::thread::hardware_concurrency()));
+        }
+
+        /**
+         * Make reads and writes of a socket fail after blocking for 'timeout', on the
+         * client side connect() as well.
+         */
+        void set_timeouts(int fd, std::chrono::milliseconds timeout) {
+            auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+            auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(timeout - secs);
+            timeval tv{};
+            tv.tv_sec = static_cast<time_t>(secs.count());
+            tv.tv_usec = static_cast<suseconds_t>(usecs.count());
+            if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0 ||
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
+                throw_errno("couldn't set socket timeout");
+        }
+
+        sockaddr_un make_address(const std::string &socket_path) {
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            if (socket_path.size() >= sizeof(addr.sun_path))
+                throw std::invalid_argument("CompileServer: socket path is too long: " + socket_path);
+            std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+            return addr;
+        }
+    }
+
+    CompileServer::CompileServer(std::string socket_path, std::chrono::milliseconds io_timeout) :
+            socket_path(std::move(socket_path)),
+            io_timeout(io_timeout),
+            max_connections(std::max(1u, std::thread::hardware_concurrency())),
+            connection_slots(max_connections) {
+        sockaddr_un addr = make_address(this->socket_path);
+
+        // only a stale socket is replaced, never a file that happens to be in the way
+        struct stat st;
+        if (lstat(this->socket_path.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode))
+                throw std::system_error(std::make_error_code(std::errc::file_exists),
+                                        "CompileServer: not a socket: " + this->socket_path);
+            unlink(this->socket_path.c_str());
+        } else if (errno != ENOENT)
+            throw_errno("couldn't stat " + this->socket_path);
+
+        socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket_fd < 0)
+            throw_errno("couldn't create socket");
+
+        // the destructor doesn't run when the constructor throws
+        bool bound = false;
+        try {
+            if (bind(socket_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+                throw_errno("couldn't bind socket " + this->socket_path);
+            bound = true;
+            if (listen(socket_fd, SOMAXCONN) < 0)
+                throw_errno("couldn't listen on socket " + this->socket_path);
+
+            warm_up();
+        }
+        catch (...) {
+            close(socket_fd);
+            if (bound)
+                unlink(this->socket_path.c_str());
+            throw;
+        }
+    }
+
+    CompileServer::~CompileServer() {
+        if (socket_fd >= 0) {
+            close(socket_fd);
+            unlink(socket_path.c_str());
+        }
+    }
+
+    void CompileServer::serve() {
+        while (true) {
+            // the connections over the limit wait in the listen queue
+            connection_slots.acquire();
+            int connection_fd = accept(socket_fd, nullptr, nullptr);
+            if (connection_fd < 0) {
+                int accept_errno = errno;
+                connection_slots.release();
+                if (!stopping && (accept_errno == EINTR || accept_errno == ECONNABORTED))
+                    continue;
+
+                // the threads still handling connections use the slots
+                for (unsigned i = 0; i < max_connections; i++)
+                    connection_slots.acquire();
+                for (unsigned i = 0; i < max_connections; i++)
+                    connection_slots.release();
+                if (stopping)
+                    return;
+                errno = accept_errno;
+                throw_errno("accept failed");
+            }
+            std::thread([this, connection_fd]() {
+                handle(connection_fd, io_timeout);
+                connection_slots.release();
+            }).detach();
+        }
+    }
+
+    void CompileServer::stop() {
+        stopping = true;
+        // wakes up accept() in serve()
+        shutdown(socket_fd, SHUT_RDWR);
+    }
+
+    void CompileServer::handle(int connection_fd, std::chrono::milliseconds io_timeout) {
+        Connection conn(connection_fd);
+        try {
+            // the compilation isn't limited, only the waiting for the client
+            set_timeouts(connection_fd, io_timeout);
+            // the length of the body can't be trusted before the magic is checked
+            if (conn.read_num<uint32_t>() != protocol_magic) {
+                reply_not_handled(conn, "not a cpm compile request");
+                return;
+            }
+            auto version = conn.read_num<uint32_t>();
+            std::string body_data;
+            try {
+                body_data = conn.read_str(max_body_size);
+            }
+            catch (const std::length_error &) {
+                reply_not_handled(conn, "request is larger than " +
+                                        std::to_string(max_body_size) + " bytes");
+                return;
+            }
+            Reader body(body_data);
+            if (version != protocol_version) {
+                reply_not_handled(conn, "protocol version " + std::to_string(version) +
+                                        " of the client doesn't match version " +
+                                        std::to_string(protocol_version) + " of the server");
+                return;
+            }
+
+            driver::CompileOptions opts;
+            auto opt_level = body.read_num<uint8_t>();
+            auto emit_kind = body.read_num<uint8_t>();
+            if (opt_level > static_cast<uint8_t>(OptLevel::O3)) {
+                reply_not_handled(conn, "invalid optimization level " +
+                                        std::to_string(opt_level));
+                return;
+            }
+            if (emit_kind > static_cast<uint8_t>(EmitKind::Object)) {
+                reply_not_handled(conn, "invalid output kind " + std::to_string(emit_kind));
+                return;
+            }
+            opts.opt_level = static_cast<OptLevel>(opt_level);
+            opts.emit_kind = static_cast<EmitKind>(emit_kind);
+            auto flags = body.read_num<uint8_t>();
+            opts.ast_dump_raw = flags & AstDumpRaw;
+            opts.ast_dump = flags & AstDump;
+            opts.time = flags & Time;
+            opts.discard_value_names = flags & DiscardValueNames;
+            opts.ssa_locals = flags & SsaLocals;
+            opts.whole_program = flags & WholeProgram;
+            opts.max_errors = body.read_num<uint32_t>();
+            opts.sema_threads = clamp_threads(body.read_num<uint32_t>());
+            opts.codegen_threads = clamp_threads(body.read_num<uint32_t>());
+            istringstream source(body.read_str());
+
+            ostringstream out, log, err;
+            int exit_code = driver::compile(source, std::nullopt, opts, {out, log, err});
+
+            conn.write_num<int32_t>(exit_code);
+            conn.write_str(out.str());
+            conn.write_str(log.str());
+            conn.write_str(err.str());
+        }
+        catch (const std::exception &) {
+            // the client went away or sent garbage, there's nobody to report to
+        }
+    }
+
+    void CompileServer::warm_up() {
+        driver::CompileOptions opts;
+        opts.emit_kind = EmitKind::Object;
+        istringstream source("int main() { return 0; }");
+        ostringstream out, log, err;
+        driver::compile(source, std::nullopt, opts, {out, log, err});
+    }
+
+    std::optional<Response> request_compile(const std::string &socket_path, const Request &req,
+                                            std::chrono::milliseconds timeout) {
+        sockaddr_un addr;
+        try {
+            addr = make_address(socket_path);
+        }
+        catch (const std::invalid_argument &) {
+            return std::nullopt;
+        }
+
+        // the server would refuse it, don't make it read the source first
+        if (req.source.size() > max_source_size)
+            return std::nullopt;
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return std::nullopt;
+        Connection conn(fd);
+        try {
+            // a daemon that hangs makes the client compile by itself instead
+            set_timeouts(fd, timeout);
+        }
+        catch (const std::system_error &) {
+            return std::nullopt;
+        }
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+            return std::nullopt;
+
+        try {
+            uint8_t flags = (req.opts.ast_dump_raw ? AstDumpRaw : 0) |
+                            (req.opts.ast_dump ? AstDump : 0) |
+                            (req.opts.time ? Time : 0) |
+                            (req.opts.discard_value_names ? DiscardValueNames : 0) |
+                            (req.opts.ssa_locals ? SsaLocals : 0) |
+                            (req.opts.whole_program ? WholeProgram : 0);
+            Writer body;
+            body.write_num<uint8_t>(static_cast<uint8_t>(req.opts.opt_level));
+            body.write_num<uint8_t>(static_cast<uint8_t>(req.opts.emit_kind));
+            body.write_num<uint8_t>(flags);
+            body.write_num<uint32_t>(req.opts.max_errors);
+            body.write_num<uint32_t>(req.opts.sema_threads);
+            body.write_num<uint32_t>(req.opts.codegen_threads);
+            body.write_str(req.source);
+            conn.write_num<uint32_t>(protocol_magic);
+            conn.write_num<uint32_t>(protocol_version);
+            conn.write_str(body.getData());
+
+            Response res;
+            res.exit_code = conn.read_num<int32_t>();
+            if (res.exit_code == not_handled)
+                return std::nullopt;
+            res.out = conn.read_str();
+            res.log = conn.read_str();
+            res.err = conn.read_str();
+            return res;
+        }
+        catch (const std::exception &) {
+            return std::nullopt;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <semaphore>
+#include <string>
+
+#include "driver/Driver.h"
+
+namespace cpm::server {
+    /**
+     * Compile request sent from the client to the daemon.
+     */
+    struct Request {
+        // 'run' and 'stats' aren't sent, the client handles them by compiling locally
+        driver::CompileOptions opts;
+        // the source code to be compiled
+        std::string source;
+    };
+
+    /**
+     * Result of a compilation, sent from the daemon back to the client.
+     */
+    struct Response {
+        int exit_code = driver::exitCode(driver::ReturnValue::Failure);
+        // output of the compilation (ir, object file, ...)
+        std::string out;
+        // warnings and other messages
+        std::string log;
+        // errors
+        std::string err;
+    };
+
+    /**
+     * Persistent compile server (cpm --daemon).
+     *
+     * Listens on a local unix socket and compiles the requests it gets, each
+     * connection on its own thread. Since the process lives on, the antlr parser
+     * keeps its warm DFA cache and llvm targets stay initialized between compilations.
+     *
+     * At most one connection per core is handled at a time, the others wait until
+     * a compilation finishes. The threads a request asks for are limited to the
+     * number of cores as well. A client that doesn't send its request or doesn't read
+     * the response within the io timeout is disconnected, so idle clients can't keep
+     * the others out.
+     */
+    class CompileServer {
+    public:
+        static constexpr std::chrono::milliseconds default_io_timeout = std::chrono::seconds(10);
+
+        /**
+         * Create the socket and start listening on it.
+         *
+         * A stale socket file left by a previous server is replaced, any other
+         * file at 'socket_path' is left alone and is an error.
+         * Throws std::system_error on failure.
+         * @param io_timeout  how long a single read or write of a connection may block
+         */
+        explicit CompileServer(std::string socket_path,
+                               std::chrono::milliseconds io_timeout = default_io_timeout);
+
+        ~CompileServer();
+
+        CompileServer(const CompileServer &) = delete;
+
+        CompileServer &operator=(const CompileServer &) = delete;
+
+        /**
+         * Accept and handle connections until stop() is called.
+         *
+         * Returns once the connections being handled are finished.
+         * Throws std::system_error on failure.
+         */
+        void serve();
+
+        /**
+         * Make serve() return, can be called from any thread.
+         */
+        void stop();
+
+    private:
+        std::string socket_path;
+        std::chrono::milliseconds io_timeout;
+        int socket_fd = -1;
+        std::atomic<bool> stopping = false;
+        // connections handled at the same time
+        const unsigned max_connections;
+        std::counting_semaphore<> connection_slots;
+
+        /**
+         * Read one request from the connection, compile it and send back the response.
+         */
+        static void handle(int connection_fd, std::chrono::milliseconds io_timeout);
+
+        /**
+         * Compile a small program, so that the first request doesn't have to wait for
+         * the initialization of antlr and llvm.
+         */
+        static void warm_up();
+    };
+
+    // larger sources aren't sent to the daemon, the client compiles them by itself
+    constexpr size_t max_source_size = 64 << 20;
+
+    // the client waits for the compilation too, not just for the transfer
+    constexpr std::chrono::milliseconds default_request_timeout = std::chrono::seconds(60);
+
+    /**
+     * Send a compile request to the daemon listening on 'socket_path'.
+     *
+     * @param timeout  how long a single read or write of the connection may block, including
+     *                 the wait for the response while the daemon compiles
+     * @return the response, or std::nullopt if the daemon can't be reached, the connection
+     *         fails or times out, or the daemon doesn't handle the request (e.g. it speaks
+     *         another version of the protocol, or the source is larger than max_source_size)
+     */
+    std::optional<Response> request_compile(const std::string &socket_path, const Request &req,
+                                            std::chrono::milliseconds timeout =
+                                                    default_request_timeout);
+}
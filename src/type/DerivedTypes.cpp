@@ -3,25 +3,20 @@
 
 namespace cpm {
 
-    template<typename Derived>
-    Derived *cast(Type *t) {
-        return dynamic_cast<Derived *>(t);
-    }
-
-    SimpleType *simple_ty(Type *t) {
-        return cast<SimpleType>(t);
-    }
-
-    PointerType *pointer_ty(Type *t) {
-        return cast<PointerType>(t);
-    }
-
-    ArrayType *array_ty(Type *t) {
-        return cast<ArrayType>(t);
-    }
-
-    FunctionType *function_ty(Type *t) {
-        return cast<FunctionType>(t);
+    SimpleType::Builtin SimpleType::builtin_of(Symbol type_id) {
+        if (type_id == "int")
+            return Builtin::Int;
+        if (type_id == "char")
+            return Builtin::Char;
+        if (type_id == "bool")
+            return Builtin::Bool;
+        if (type_id == "double")
+            return Builtin::Double;
+        if (type_id == "void")
+            return Builtin::Void;
+        if (type_id == "nullptr_t")
+            return Builtin::Nullptr;
+        return Builtin::None;
     }
 
     std::string repr_type(Type *t) {
@@ -32,7 +27,7 @@ namespace cpm {
         sep = sep_str;
         if (auto s = simple_ty(t)) {
             string c = s->isConst() ? "C" + sep : "";
-            return c + s->getTypeId();
+            return c + s->getTypeId().str();
         } else if (auto p = pointer_ty(t)) {
             string c = p->isConst() ? "C" + sep : "";
             return c + "P" + sep + repr_type(p->getElemType());
@@ -57,7 +52,7 @@ namespace cpm {
 
     std::string _to_string(Type *t) {
         if (auto r = simple_ty(t))
-            return (r->isConst() ? "const " : "") + r->getTypeId();
+            return (r->isConst() ? "const " : "") + r->getTypeId().str();
         else if (auto p = pointer_ty(t))
             return (p->isConst() ? "const ptr to " : "ptr to ") + _to_string(p->getElemType());
         else if (auto a = array_ty(t)) {
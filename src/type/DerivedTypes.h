@@ -7,24 +7,53 @@
 #include <stdexcept>
 
 #include "Type.h"
+#include "utils/Symbol.h"
 
 namespace cpm {
 
     class SimpleType : public Type {
-        std::string type_id;
+    public:
+        /**
+         * The builtin types, resolved from the type id when the type is created,
+         * so that checks like 'is this int' don't compare strings.
+         */
+        enum class Builtin : uint8_t {
+            // a user defined class
+            None,
+            Int,
+            Char,
+            Bool,
+            Double,
+            Void,
+            Nullptr
+        };
+
+    private:
+        Symbol type_id;
         bool is_const;
+        Builtin builtin;
+
+        static Builtin builtin_of(Symbol type_id);
 
     public:
-        SimpleType(std::string type_id, bool is_const) :
-                type_id(std::move(type_id)),
-                is_const(is_const) {}
+        SimpleType(Symbol type_id, bool is_const) :
+                Type(TypeKind::Simple),
+                type_id(type_id),
+                is_const(is_const),
+                builtin(builtin_of(this->type_id)) {}
 
-        const std::string &getTypeId() const { return type_id; }
+        static bool classof(const Type *t) { return t->getKind() == TypeKind::Simple; }
+
+        Symbol getTypeId() const { return type_id; }
 
         bool isConst() const { return is_const; }
 
+        Builtin getBuiltin() const { return builtin; }
+
+        bool isBuiltin(Builtin b) const { return builtin == b; }
+
         bool operator<(const SimpleType &rhs) const {
-            return type_id < rhs.type_id;
+            return type_id.str() < rhs.type_id.str();
         }
     };
 
@@ -35,9 +64,12 @@ namespace cpm {
     public:
 
         PointerType(Type *elem_type, bool is_const) :
+                Type(TypeKind::Pointer),
                 elem_type(elem_type),
                 is_const(is_const) {}
 
+        static bool classof(const Type *t) { return t->getKind() == TypeKind::Pointer; }
+
         Type *getElemType() const { return elem_type; }
 
         bool isConst() const { return is_const; }
@@ -52,10 +84,13 @@ namespace cpm {
         FunctionType(Type *ret_type,
                      std::vector<Type *> params,
                      bool vararg) :
+                Type(TypeKind::Function),
                 ret_type(ret_type),
                 params(std::move(params)),
                 vararg(vararg) {}
 
+        static bool classof(const Type *t) { return t->getKind() == TypeKind::Function; }
+
         Type *getRetType() const { return ret_type; }
 
         const std::vector<Type *> &getParams() const { return params; };
@@ -69,9 +104,12 @@ namespace cpm {
 
     public:
         ArrayType(Type *elem_type, std::optional<size_t> size) :
+                Type(TypeKind::Array),
                 elem_type(elem_type),
                 size(size) {}
 
+        static bool classof(const Type *t) { return t->getKind() == TypeKind::Array; }
+
         Type *getElemType() const { return elem_type; }
 
         const std::optional<size_t> &getSize() const { return size; }
@@ -84,16 +122,24 @@ namespace cpm {
      */
 
     /* Return pointer to SimpleType object if t is SimpleType, nullptr otherwise. */
-    SimpleType *simple_ty(Type *t);
+    inline SimpleType *simple_ty(Type *t) {
+        return dyn_cast<SimpleType>(t);
+    }
 
     /* Return pointer to PointerType object if t is PointerType, nullptr otherwise. */
-    PointerType *pointer_ty(Type *t);
+    inline PointerType *pointer_ty(Type *t) {
+        return dyn_cast<PointerType>(t);
+    }
 
     /* Return pointer to ArrayType object if t is ArrayType, nullptr otherwise. */
-    ArrayType *array_ty(Type *t);
+    inline ArrayType *array_ty(Type *t) {
+        return dyn_cast<ArrayType>(t);
+    }
 
     /* Return pointer to FunctionType object if t is FunctionType, nullptr otherwise. */
-    FunctionType *function_ty(Type *t);
+    inline FunctionType *function_ty(Type *t) {
+        return dyn_cast<FunctionType>(t);
+    }
 
     /* Returns a unique string represenanntation for each possible type.
      * Suggested use: key in map */
@@ -1,10 +1,45 @@
 #pragma once
 
+#include <cstdint>
+
 namespace cpm {
+    /**
+     * Discriminator of the derived types, see simple_ty, pointer_ty, ...
+     */
+    enum class TypeKind : uint8_t {
+        Simple,
+        Pointer,
+        Array,
+        Function
+    };
+
     class Type {
     public:
+        explicit Type(TypeKind kind) :
+                kind(kind) {}
+
         virtual ~Type() = default;
+
+        TypeKind getKind() const { return kind; }
+
+    private:
+        TypeKind kind;
     };
-}
 
+    /**
+     * llvm-style RTTI on the kind of the type, e.g. isa<PointerType>(t).
+     * T must be one of the derived types.
+     */
+    template<typename T>
+    bool isa(const Type *t) {
+        return T::classof(t);
+    }
 
+    /**
+     * @return t as T if it's of that type, nullptr otherwise (also if t is nullptr)
+     */
+    template<typename T>
+    T *dyn_cast(Type *t) {
+        return t && isa<T>(t) ? static_cast<T *>(t) : nullptr;
+    }
+}
@@ -1,34 +1,125 @@
 #include "TypeManager.h"
 
+#include <functional>
+#include <mutex>
+
 using namespace std;
 
-template<typename D, typename... Args>
-D *cpm::TypeManager::getDerivedType(D *(*cast_func)(cpm::Type *), Args... args) {
-    D tmp = D(args...);
-    std::string repr = cpm::repr_type(&tmp);
-    if (types.contains(repr))
-        return cast_func(types.at(repr).get());
-    unique_ptr<D> up = make_unique<D>(tmp);
-    D *ptr = up.get();
-    types[repr] = std::move(up);
-    return ptr;
+namespace {
+    constexpr size_t initial_capacity = 64;
+
+    size_t hash_combine(size_t seed, size_t value) {
+        // from boost::hash_combine
+        return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
+
+    size_t hash_ptr(const void *ptr) {
+        return std::hash<const void *>()(ptr);
+    }
+}
+
+template<typename T, typename Equals>
+size_t cpm::TypeManager::probe(TypeKind kind, size_t hash, Equals &equals) const {
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    // linear probing, the table is never full
+    for (; slots[i].type; i = (i + 1) & mask) {
+        const Slot &slot = slots[i];
+        if (slot.hash == hash && slot.kind == kind && equals(*static_cast<T *>(slot.type)))
+            break;
+    }
+    return i;
+}
+
+template<typename T, typename Equals, typename Create>
+T *cpm::TypeManager::intern(TypeKind kind, size_t hash, Equals equals, Create create) {
+    {
+        std::shared_lock lock(mutex);
+        if (!slots.empty())
+            if (Type *type = slots[probe<T>(kind, hash, equals)].type)
+                return static_cast<T *>(type);
+    }
+
+    std::unique_lock lock(mutex);
+    if (slots.empty())
+        slots.resize(initial_capacity);
+    // another thread may have created the type after the shared lock was released
+    size_t i = probe<T>(kind, hash, equals);
+    if (slots[i].type)
+        return static_cast<T *>(slots[i].type);
+
+    T *type = create();
+    slots[i] = {hash, type, kind};
+    // keep the load factor under 3/4
+    if (++num_types * 4 > slots.size() * 3)
+        grow();
+    return type;
+}
+
+void cpm::TypeManager::grow() {
+    vector<Slot> old = std::move(slots);
+    slots.assign(old.size() * 2, Slot());
+    size_t mask = slots.size() - 1;
+    for (const Slot &slot: old) {
+        if (!slot.type)
+            continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].type)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
 }
 
-cpm::SimpleType *cpm::TypeManager::getSimpleType(const std::string &type_id, bool is_const) {
-    return getDerivedType<cpm::SimpleType>(cpm::simple_ty, type_id, is_const);
+cpm::SimpleType *cpm::TypeManager::getSimpleType(cpm::Symbol type_id, bool is_const) {
+    size_t hash = hash_combine(type_id.hash(), is_const);
+    return intern<SimpleType>(
+            TypeKind::Simple, hash,
+            [&](const SimpleType &t) {
+                return t.isConst() == is_const && t.getTypeId() == type_id;
+            },
+            [&]() {
+                return &simple_types.emplace_back(type_id, is_const);
+            });
 }
 
 cpm::PointerType *cpm::TypeManager::getPointerType(cpm::Type *elem_type, bool is_const) {
-    return getDerivedType<cpm::PointerType>(cpm::pointer_ty, elem_type, is_const);
+    size_t hash = hash_combine(hash_ptr(elem_type), is_const);
+    return intern<PointerType>(
+            TypeKind::Pointer, hash,
+            [&](const PointerType &t) {
+                return t.getElemType() == elem_type && t.isConst() == is_const;
+            },
+            [&]() {
+                return &pointer_types.emplace_back(elem_type, is_const);
+            });
 }
 
 cpm::ArrayType *cpm::TypeManager::getArrayType(cpm::Type *elem_type, std::optional<size_t> size) {
-    return getDerivedType<cpm::ArrayType>(cpm::array_ty, elem_type, size);
+    size_t hash = hash_combine(hash_ptr(elem_type), size.has_value());
+    hash = hash_combine(hash, size.value_or(0));
+    return intern<ArrayType>(
+            TypeKind::Array, hash,
+            [&](const ArrayType &t) {
+                return t.getElemType() == elem_type && t.getSize() == size;
+            },
+            [&]() {
+                return &array_types.emplace_back(elem_type, size);
+            });
 }
 
 cpm::FunctionType *
 cpm::TypeManager::getFunctionType(cpm::Type *ret_type, std::vector<cpm::Type *> params,
                                   bool is_vararg) {
-    return getDerivedType<cpm::FunctionType>(cpm::function_ty, ret_type, std::move(params),
-                                             is_vararg);
+    size_t hash = hash_combine(hash_ptr(ret_type), is_vararg);
+    for (Type *param: params)
+        hash = hash_combine(hash, hash_ptr(param));
+    return intern<FunctionType>(
+            TypeKind::Function, hash,
+            [&](const FunctionType &t) {
+                return t.getRetType() == ret_type && t.isVararg() == is_vararg &&
+                       t.getParams() == params;
+            },
+            [&]() {
+                return &function_types.emplace_back(ret_type, std::move(params), is_vararg);
+            });
 }
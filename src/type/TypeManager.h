@@ -1,8 +1,12 @@
 #pragma once
 
-#include <map>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 
 #include "type/Type.h"
 #include "type/DerivedTypes.h"
@@ -10,12 +14,24 @@
 namespace cpm {
     /**
      * A type 'context' that manages types.
+     *
+     * Every type exists only once (types are hash-consed), so types can be compared
+     * by pointers. The types are looked up by their structure - kind, component types
+     * and qualifiers - in an open addressing hash table. Component types and type ids
+     * are already unique, so they're hashed and compared as pointers.
+     *
+     * The manager is thread-safe: lookups of existing types only take a shared lock,
+     * creating a type takes an exclusive one.
      */
     class TypeManager {
     public:
         TypeManager() = default;
 
-        cpm::SimpleType *getSimpleType(const std::string &type_id, bool is_const);
+        TypeManager(const TypeManager &) = delete;
+
+        TypeManager &operator=(const TypeManager &) = delete;
+
+        cpm::SimpleType *getSimpleType(cpm::Symbol type_id, bool is_const);
 
         cpm::PointerType *getPointerType(cpm::Type *elem_type, bool is_const);
 
@@ -24,11 +40,47 @@ namespace cpm {
         cpm::FunctionType *getFunctionType(cpm::Type *ret_type, std::vector<cpm::Type *> params,
                                            bool is_vararg);
 
+        /**
+         * @return number of distinct types created so far
+         */
+        size_t size() const {
+            std::shared_lock lock(mutex);
+            return num_types;
+        }
+
     private:
-        std::map<std::string, std::unique_ptr<cpm::Type>> types;
+        struct Slot {
+            size_t hash = 0;
+            cpm::Type *type = nullptr;
+            // copy of the kind of the type, saves a dereference when probing
+            cpm::TypeKind kind = cpm::TypeKind::Simple;
+        };
+
+        mutable std::shared_mutex mutex;
+        // the hash table, size is always a power of two, empty slots have no type
+        std::vector<Slot> slots;
+        size_t num_types = 0;
+
+        // storage of the types, deque never moves its elements and allocates them in blocks
+        std::deque<cpm::SimpleType> simple_types;
+        std::deque<cpm::PointerType> pointer_types;
+        std::deque<cpm::ArrayType> array_types;
+        std::deque<cpm::FunctionType> function_types;
+
+        /**
+         * Find a type with given hash for which 'equals' returns true, create it by 'create'
+         * if there's none.
+         */
+        template<typename T, typename Equals, typename Create>
+        T *intern(cpm::TypeKind kind, size_t hash, Equals equals, Create create);
+
+        /**
+         * @return index of the slot of the type with given hash for which 'equals' returns true,
+         * or of the empty slot where it belongs
+         */
+        template<typename T, typename Equals>
+        size_t probe(cpm::TypeKind kind, size_t hash, Equals &equals) const;
 
-        // helper for the funcs above
-        template<typename T, typename ... Args>
-        T *getDerivedType(T *(*cast_func)(cpm::Type *), Args... args);
+        void grow();
     };
 }
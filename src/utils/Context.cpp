@@ -1,18 +1,55 @@
-#include <sstream>
 #include "Context.h"
 
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace cpm {
     Context::Context(std::istream &ifs) :
-            input(std::string(std::istreambuf_iterator<char>(ifs),
-                              std::istreambuf_iterator<char>())),
-            lines{"line 0, this should not be accessed"} {
-        std::stringstream ss(input);
-        std::string line;
-        while (std::getline(ss, line, '\n'))
-            lines.push_back(line);
+            owned_input(std::string(std::istreambuf_iterator<char>(ifs),
+                                    std::istreambuf_iterator<char>())),
+            input(owned_input) {}
+
+    Context::Context(const std::filesystem::path &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(),
+                                    "couldn't open file " + path.string());
+        struct stat st{};
+        if (fstat(fd, &st) < 0) {
+            int err = errno;
+            close(fd);
+            throw std::system_error(err, std::generic_category(),
+                                    "couldn't stat file " + path.string());
+        }
+        mapped_size = st.st_size;
+        // an empty file can't be mapped, the input is simply empty then
+        if (mapped_size) {
+            mapped_input = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped_input == MAP_FAILED) {
+                int err = errno;
+                mapped_input = nullptr;
+                close(fd);
+                throw std::system_error(err, std::generic_category(),
+                                        "couldn't map file " + path.string());
+            }
+            input = std::string_view(static_cast<const char *>(mapped_input), mapped_size);
+        }
+        // the mapping stays valid after the file is closed
+        close(fd);
+    }
+
+    Context::~Context() {
+        if (mapped_input)
+            munmap(mapped_input, mapped_size);
     }
 
-    cpm::SimpleType *Context::getSimpleType(const std::string &type_id, bool is_const) {
+    cpm::SimpleType *Context::getSimpleType(cpm::Symbol type_id, bool is_const) {
         return tm.getSimpleType(type_id, is_const);
     }
 
@@ -29,11 +66,32 @@ namespace cpm {
         return tm.getFunctionType(ret_type, std::move(params), is_vararg);
     }
 
-    const std::string &Context::getInput() const {
+    std::string_view Context::getInput() const {
         return input;
     }
 
-    const std::vector<std::string> &Context::getInputByLines() const {
-        return lines;
+    std::string_view Context::getLine(size_t line_no) const {
+        if (line_no == 0)
+            return "line 0, this should not be accessed";
+
+        std::call_once(line_offsets_flag, [this] { build_line_offsets(); });
+        if (line_no > line_offsets.size())
+            throw std::out_of_range("Context::getLine: no line " + std::to_string(line_no));
+
+        size_t begin = line_offsets[line_no - 1];
+        size_t end = input.find('\n', begin);
+        if (end == std::string_view::npos)
+            end = input.size();
+        return input.substr(begin, end - begin);
+    }
+
+    void Context::build_line_offsets() const {
+        // a line starts at the beginning of the input and after every '\n',
+        // unless the '\n' is the last character
+        if (!input.empty())
+            line_offsets.push_back(0);
+        for (size_t i = 0; i < input.size(); i++)
+            if (input[i] == '\n' && i + 1 < input.size())
+                line_offsets.push_back(i + 1);
     }
-}
\ No newline at end of file
+}
@@ -2,10 +2,14 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <istream>
+#include <filesystem>
+#include <mutex>
 
 #include "type/DerivedTypes.h"
 #include "type/TypeManager.h"
+#include "Symbol.h"
 
 namespace cpm {
     /**
@@ -13,13 +17,51 @@ namespace cpm {
      */
     class Context {
     public:
+        /**
+         * Read the source code from a stream.
+         */
         explicit Context(std::istream &ifs);
 
-        const std::string &getInput() const;
+        /**
+         * Memory-map the source file, its contents are not copied.
+         *
+         * Throws std::system_error if the file can't be opened or mapped.
+         */
+        explicit Context(const std::filesystem::path &path);
 
-        const std::vector<std::string> &getInputByLines() const;
+        ~Context();
 
-        cpm::SimpleType *getSimpleType(const std::string &type_id, bool is_const);
+        Context(const Context &) = delete;
+
+        Context &operator=(const Context &) = delete;
+
+        /**
+         * The whole source code. The view is valid as long as the context.
+         */
+        std::string_view getInput() const;
+
+        /**
+         * Get a line of the source code, lines are numbered from 1.
+         *
+         * Line 0 is reserved for nodes that don't come from the source code,
+         * a placeholder text is returned for it.
+         * Throws std::out_of_range if there's no such line.
+         */
+        std::string_view getLine(size_t line_no) const;
+
+        /**
+         * Intern an identifier, symbols of the same string are equal in the whole
+         * compilation of the source file.
+         */
+        cpm::Symbol intern(std::string_view str) {
+            return symbols.intern(str);
+        }
+
+        cpm::SimpleType *getSimpleType(cpm::Symbol type_id, bool is_const);
+
+        cpm::SimpleType *getSimpleType(std::string_view type_id, bool is_const) {
+            return getSimpleType(intern(type_id), is_const);
+        }
 
         cpm::PointerType *getPointerType(cpm::Type *elem_type, bool is_const);
 
@@ -29,9 +71,20 @@ namespace cpm {
                                            bool is_vararg);
 
     private:
+        // the types refer to the symbols, so they're declared first
+        SymbolTable symbols;
         TypeManager tm;
-        std::string input;
-        std::vector<std::string> lines;
+        // source read from a stream is owned here, a file is mapped instead
+        std::string owned_input;
+        void *mapped_input = nullptr;
+        size_t mapped_size = 0;
+        std::string_view input;
+
+        // offsets of line starts in the input, built on the first use of getLine
+        mutable std::vector<size_t> line_offsets;
+        mutable std::once_flag line_offsets_flag;
+
+        void build_line_offsets() const;
     };
 
 }
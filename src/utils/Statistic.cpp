@@ -0,0 +1,46 @@
+#include "Statistic.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace cpm {
+    namespace {
+        struct Registry {
+            std::mutex mutex;
+            std::vector<const Statistic *> stats;
+        };
+
+        // function-local static, so that the registry exists before the first
+        // Statistic registers itself, regardless of static initialization order
+        Registry &registry() {
+            static Registry r;
+            return r;
+        }
+    }
+
+    Statistic::Statistic(std::string group, std::string name, std::string desc) :
+            group(std::move(group)),
+            name(std::move(name)),
+            desc(std::move(desc)) {
+        Registry &r = registry();
+        std::lock_guard lock(r.mutex);
+        r.stats.push_back(this);
+    }
+
+    void Statistic::print_all(std::ostream &os) {
+        Registry &r = registry();
+        std::lock_guard lock(r.mutex);
+        std::vector<const Statistic *> sorted = r.stats;
+        std::sort(sorted.begin(), sorted.end(), [](const Statistic *a, const Statistic *b) {
+            return std::tie(a->group, a->name) < std::tie(b->group, b->name);
+        });
+
+        os << "=== statistics ===" << std::endl;
+        for (const Statistic *s: sorted)
+            os << std::setw(10) << s->get() << " " << s->group << "." << s->name
+               << " - " << s->desc << std::endl;
+    }
+}
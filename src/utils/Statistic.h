@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace cpm {
+    /**
+     * A named process-wide counter, similar to llvm's STATISTIC.
+     *
+     * Counters are defined as globals in the translation unit that updates them,
+     * and they register themselves, so that all of them can be printed at once
+     * (cpm --stats). Updates are atomic, counters can be updated from worker threads.
+     *
+     * e.g.
+     *      static cpm::Statistic num_sll("parser", "sll", "files parsed with SLL prediction");
+     *      ++num_sll;
+     */
+    class Statistic {
+    public:
+        Statistic(std::string group, std::string name, std::string desc);
+
+        Statistic(const Statistic &) = delete;
+
+        Statistic &operator=(const Statistic &) = delete;
+
+        Statistic &operator++() {
+            value.fetch_add(1, std::memory_order_relaxed);
+            return *this;
+        }
+
+        Statistic &operator+=(size_t n) {
+            value.fetch_add(n, std::memory_order_relaxed);
+            return *this;
+        }
+
+        size_t get() const {
+            return value.load(std::memory_order_relaxed);
+        }
+
+        const std::string &getGroup() const { return group; }
+
+        const std::string &getName() const { return name; }
+
+        const std::string &getDesc() const { return desc; }
+
+        /**
+         * Print all registered counters, sorted by group and name.
+         */
+        static void print_all(std::ostream &os);
+
+    private:
+        std::string group;
+        std::string name;
+        std::string desc;
+        std::atomic<size_t> value = 0;
+    };
+}
@@ -0,0 +1,36 @@
+#include "Symbol.h"
+
+#include <mutex>
+
+#include "Statistic.h"
+
+namespace {
+    cpm::Statistic num_symbols("context", "symbols", "distinct identifiers interned");
+}
+
+namespace cpm {
+    Symbol SymbolTable::intern(std::string_view str) {
+        if (str.empty())
+            return {};
+        {
+            std::shared_lock lock(mutex);
+            auto it = index.find(str);
+            if (it != index.end())
+                return Symbol(it->second);
+        }
+        std::unique_lock lock(mutex);
+        // another thread may have added it after the shared lock was released
+        auto it = index.find(str);
+        if (it != index.end())
+            return Symbol(it->second);
+        const std::string &stored = strings.emplace_back(str);
+        index.emplace(stored, &stored);
+        ++num_symbols;
+        return Symbol(&stored);
+    }
+
+    size_t SymbolTable::size() const {
+        std::shared_lock lock(mutex);
+        return strings.size();
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <shared_mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace cpm {
+    /**
+     * Handle of an identifier interned in a SymbolTable.
+     *
+     * A table keeps every distinct string only once, so two symbols of the same table
+     * are equal iff their strings are equal - symbols are compared and hashed
+     * by address, not by characters. The string is valid as long as the table.
+     *
+     * The default constructed symbol is the empty string, the same one
+     * SymbolTable::intern("") returns.
+     */
+    class Symbol {
+    public:
+        Symbol() = default;
+
+        const std::string &str() const { return *text; }
+
+        operator const std::string &() const { return *text; }
+
+        bool empty() const { return text->empty(); }
+
+        size_t hash() const { return std::hash<const void *>()(text); }
+
+        bool operator==(const Symbol &rhs) const = default;
+
+        friend bool operator==(Symbol lhs, std::string_view rhs) {
+            return *lhs.text == rhs;
+        }
+
+        friend std::ostream &operator<<(std::ostream &os, Symbol symbol) {
+            return os << *symbol.text;
+        }
+
+    private:
+        friend class SymbolTable;
+
+        static inline const std::string empty_string;
+
+        const std::string *text = &empty_string;
+
+        explicit Symbol(const std::string *text) : text(text) {}
+    };
+
+    struct SymbolHash {
+        size_t operator()(Symbol symbol) const {
+            return symbol.hash();
+        }
+    };
+
+    /**
+     * Interns identifiers, see Symbol.
+     *
+     * Interning is thread-safe, symbols that already exist are looked up under a shared lock.
+     */
+    class SymbolTable {
+    public:
+        SymbolTable() = default;
+
+        SymbolTable(const SymbolTable &) = delete;
+
+        SymbolTable &operator=(const SymbolTable &) = delete;
+
+        /**
+         * @return the symbol of 'str', the string is copied into the table on the first use
+         */
+        Symbol intern(std::string_view str);
+
+        /**
+         * @return number of distinct symbols, not counting the empty one
+         */
+        size_t size() const;
+
+    private:
+        mutable std::shared_mutex mutex;
+        // deque never moves its elements, so the symbols and the keys of 'index' stay valid
+        std::deque<std::string> strings;
+        std::unordered_map<std::string_view, const std::string *> index;
+    };
+}
@@ -0,0 +1,171 @@
+/**
+ * This program tests that compiling multiple files in one invocation doesn't depend on the
+ * number of jobs.
+ *
+ * All samples from the directories given as arguments are compiled with -j1 and with -j4.
+ * Both batches must write the same output files, print the same reports in the same order and
+ * return the same exit code. Inputs that would be compiled into the same output file must be
+ * rejected in both.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "driver/Driver.h"
+#include "tests/configure.cmake.h"
+
+namespace {
+    struct BatchResult {
+        int exit_code;
+        std::string out;
+        std::string err;
+        // output file name -> contents
+        std::map<std::string, std::string> outputs;
+
+        bool operator==(const BatchResult &) const = default;
+    };
+
+    std::string readFile(const std::filesystem::path &path) {
+        std::ifstream ifs(path, std::ios::binary);
+        std::ostringstream ss;
+        ss << ifs.rdbuf();
+        return ss.str();
+    }
+
+    /**
+     * Send everything written to the stream into a string for the lifetime of the object.
+     */
+    class Capture {
+    public:
+        explicit Capture(std::ostream &stream)
+                : stream(stream), saved(stream.rdbuf(buffer.rdbuf())) {}
+
+        ~Capture() {
+            stream.rdbuf(saved);
+        }
+
+        std::string str() const {
+            return buffer.str();
+        }
+
+    private:
+        std::ostream &stream;
+        std::ostringstream buffer;
+        std::streambuf *saved;
+    };
+
+    /**
+     * Compile the inputs, which are all in 'dir', after removing the outputs of a previous batch.
+     */
+    BatchResult compileBatch(const std::vector<std::string> &inputs,
+                             const std::filesystem::path &dir, unsigned jobs) {
+        const std::string extension = cpm::driver::output_extension(cpm::EmitKind::LLVMIR);
+        for (const auto &entry: std::filesystem::directory_iterator(dir))
+            if (entry.path().extension() == extension)
+                std::filesystem::remove(entry.path());
+
+        BatchResult result;
+        {
+            Capture out(std::cout), err(std::cerr);
+            result.exit_code =
+                    cpm::driver::compile_batch(inputs, cpm::driver::CompileOptions(), jobs);
+            result.out = out.str();
+            result.err = err.str();
+        }
+        for (const auto &entry: std::filesystem::directory_iterator(dir))
+            if (entry.path().extension() == extension)
+                result.outputs[entry.path().filename().string()] = readFile(entry.path());
+        return result;
+    }
+
+    bool sameForJobs(const std::vector<std::string> &inputs, const std::filesystem::path &dir,
+                     const BatchResult &serial) {
+        const BatchResult parallel = compileBatch(inputs, dir, 4);
+        if (parallel == serial)
+            return true;
+
+        std::cout << "error: batch with -j4 differs from -j1 (exit code " << parallel.exit_code
+                  << " vs " << serial.exit_code << ", " << parallel.outputs.size() << " vs "
+                  << serial.outputs.size() << " output files)" << std::endl;
+        std::cout << "-j1 reports:" << std::endl << serial.err;
+        std::cout << "-j4 reports:" << std::endl << parallel.err;
+        return false;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "Missing directory with samples" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto testdir = std::filesystem::path{CMAKE_CURRENT_BINARY_DIR} / "tests" / "batch";
+    std::filesystem::remove_all(testdir);
+    std::filesystem::create_directories(testdir);
+
+    // the samples are copied, the outputs are written next to the inputs; the invalid ones
+    // keep the name of their directory so the names don't collide
+    std::vector<std::string> inputs;
+    std::vector<std::string> invalidInputs;
+    for (int i = 1; i < argc; i++) {
+        const std::filesystem::path sampleDir{argv[i]};
+        const bool invalid =
+                sampleDir.lexically_normal().string().find("invalid") != std::string::npos;
+        for (const auto &entry: std::filesystem::directory_iterator(sampleDir)) {
+            if (entry.path().extension() != ".cpp")
+                continue;
+            std::string name = entry.path().filename().string();
+            if (invalid)
+                name = sampleDir.filename().string() + "_" + name;
+            std::filesystem::copy_file(entry.path(), testdir / name);
+            inputs.push_back((testdir / name).string());
+            if (invalid)
+                invalidInputs.push_back(inputs.back());
+        }
+    }
+    std::sort(inputs.begin(), inputs.end());
+
+    const BatchResult serial = compileBatch(inputs, testdir, 1);
+    if (!sameForJobs(inputs, testdir, serial))
+        return EXIT_FAILURE;
+
+    // each file that fails reports under its own name
+    for (const std::string &input: invalidInputs)
+        if (serial.err.find(input + ":\n") == std::string::npos) {
+            std::cout << "error: no report for " << input << std::endl;
+            return EXIT_FAILURE;
+        }
+    const int success = cpm::driver::exitCode(cpm::driver::ReturnValue::Success);
+    if (!invalidInputs.empty() && serial.exit_code == success) {
+        std::cout << "error: batch with invalid inputs succeeded" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (serial.outputs.size() + invalidInputs.size() < inputs.size()) {
+        std::cout << "error: only " << serial.outputs.size() << " output files for "
+                  << inputs.size() - invalidInputs.size() << " valid inputs" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // 'clash.cpp' and 'clash.cc' both compile into 'clash.ll', nothing may be compiled
+    const auto clashDir = testdir / "clash";
+    std::filesystem::create_directories(clashDir);
+    std::filesystem::copy_file(inputs.front(), clashDir / "clash.cpp");
+    std::filesystem::copy_file(inputs.front(), clashDir / "clash.cc");
+    const std::vector<std::string> clashInputs = {
+            inputs.front(), (clashDir / "clash.cpp").string(), (clashDir / "clash.cc").string()};
+    const BatchResult clash = compileBatch(clashInputs, clashDir, 1);
+    if (clash.exit_code == success || !clash.outputs.empty() ||
+        clash.err.find("clash.ll") == std::string::npos) {
+        std::cout << "error: inputs with the same output file weren't rejected" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!sameForJobs(clashInputs, clashDir, clash))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,307 @@
+/**
+ * This program tests the shape of the llvm ir generated for a sample, with each of the codegen
+ * options. The modules must be valid, and the sidecar files of the sample (.static, .ssa,
+ * .folded, .effects) list what more they must or mustn't contain.
+ *
+ * The samples are run by the run test.
+ */
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <llvm/IR/Instructions.h>
+#include "emitter/Emitter.h"
+#include "ll_builder/LLBuilder.h"
+#include "optimizer/Optimizer.h"
+#include "parser/Parser.h"
+#include "semantic_checker/SemanticChecker.h"
+
+using namespace std::string_literals;
+
+namespace {
+    std::optional<std::string> readFile(const std::filesystem::path &path) {
+        if (!std::filesystem::exists(path)) {
+            return {};
+        }
+
+        std::ifstream ifs(path);
+        std::ostringstream ss;
+        ss << ifs.rdbuf();
+        return ss.str();
+    }
+
+    /**
+     * Optimize the module the same way the driver does it at -O2.
+     */
+    void optimize(llvm::Module &module) {
+        cpm::Emitter emitter(cpm::EmitKind::Object, cpm::OptLevel::O2);
+        emitter.prepareModule(module);
+        cpm::Optimizer(cpm::OptLevel::O2, emitter.getTargetMachine()).run(module);
+    }
+
+    std::string printModule(cpm::LLBuilder &builder) {
+        std::ostringstream os;
+        builder.dumpModule(os);
+        return os.str();
+    }
+
+    /**
+     * @return the first alloca of the module, nullptr if there's none
+     */
+    const llvm::AllocaInst *anyAlloca(llvm::Module &module) {
+        for (llvm::Function &func: module)
+            for (llvm::BasicBlock &block: func)
+                for (llvm::Instruction &inst: block)
+                    if (auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst))
+                        return alloca;
+        return nullptr;
+    }
+
+    /**
+     * @return an alloca that isn't in the entry block of its function, nullptr if there's none
+     */
+    const llvm::AllocaInst *allocaOutsideEntryBlock(llvm::Module &module) {
+        for (llvm::Function &func: module)
+            for (llvm::BasicBlock &block: func)
+                for (llvm::Instruction &inst: block)
+                    if (auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst);
+                            alloca && &block != &func.getEntryBlock())
+                        return alloca;
+        return nullptr;
+    }
+
+    /**
+     * @return whether the value is a ptrtoint, also one folded into a constant expression
+     */
+    bool containsPtrToInt(const llvm::Value *val) {
+        if (const auto *op = llvm::dyn_cast<llvm::Operator>(val);
+                op && op->getOpcode() == llvm::Instruction::PtrToInt)
+            return true;
+        if (const auto *expr = llvm::dyn_cast<llvm::ConstantExpr>(val))
+            for (const llvm::Value *operand: expr->operand_values())
+                if (containsPtrToInt(operand))
+                    return true;
+        return false;
+    }
+
+    /**
+     * @return a description of the code generated for a constant that should have been
+     *         folded by the semantic checker (a branch of an if or a sizeof), empty if none
+     */
+    std::string unfoldedCode(llvm::Module &module) {
+        for (llvm::Function &func: module)
+            for (llvm::BasicBlock &block: func) {
+                if (block.getName().startswith("if."))
+                    return "block " + block.getName().str() + " in " + func.getName().str();
+                for (llvm::Instruction &inst: block) {
+                    if (containsPtrToInt(&inst))
+                        return "ptrtoint in " + func.getName().str();
+                    for (const llvm::Value *operand: inst.operand_values())
+                        if (containsPtrToInt(operand))
+                            return "ptrtoint in " + func.getName().str();
+                }
+            }
+        return "";
+    }
+
+    /**
+     * @return whether the function has an attribute of the .effects file: readnone, readonly
+     *         (implied by readnone) or norecurse
+     */
+    bool hasEffect(const llvm::Function &func, const std::string &effect) {
+        if (effect == "readnone")
+            return func.doesNotAccessMemory();
+        if (effect == "readonly")
+            return func.onlyReadsMemory();
+        if (effect == "norecurse")
+            return func.doesNotRecurse();
+        throw std::invalid_argument("unknown effect '" + effect + "'");
+    }
+
+    /**
+     * @return a function that isn't nounwind, or a definition other than main that isn't
+     *         internal if the module is the whole program; nullptr if there's none
+     */
+    const llvm::Function *wrongLinkageOrUnwind(llvm::Module &module, bool wholeProgram) {
+        for (const llvm::Function &func: module) {
+            if (!func.doesNotThrow())
+                return &func;
+            if (wholeProgram && !func.isDeclaration() && func.getName() != "main" &&
+                !func.hasLocalLinkage())
+                return &func;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @return whether the global variable of the sample has a static initializer, which
+     *         the global constructors don't overwrite
+     */
+    bool staticallyInitialized(llvm::Module &module, const std::string &name) {
+        const llvm::GlobalVariable *global = module.getGlobalVariable("global_" + name);
+        if (!global || !global->hasInitializer())
+            return false;
+        if (const llvm::Function *ctors = module.getFunction("run_global_ctors.cpp"))
+            for (const llvm::BasicBlock &block: *ctors)
+                for (const llvm::Instruction &inst: block)
+                    if (auto *store = llvm::dyn_cast<llvm::StoreInst>(&inst);
+                            store && store->getPointerOperand()->stripInBoundsOffsets() == global)
+                        return false;
+        return true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cout << "Missing filepath" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream ifs(argv[1]);
+    if (!ifs || !ifs.is_open()) {
+        std::cout << "File " << argv[1] << " could not be opened." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto inputFilepath = std::filesystem::path{argv[1]};
+    const auto fileStatic =
+            inputFilepath.parent_path() / (std::string{inputFilepath.stem()} + ".static"s);
+    const auto fileEffects =
+            inputFilepath.parent_path() / (std::string{inputFilepath.stem()} + ".effects"s);
+    const auto fileFolded =
+            inputFilepath.parent_path() / (std::string{inputFilepath.stem()} + ".folded"s);
+    const auto fileSsa =
+            inputFilepath.parent_path() / (std::string{inputFilepath.stem()} + ".ssa"s);
+
+    cpm::Context context(ifs);
+    Parser p(context);
+    ast::node_ptr<ast::TranslationUnit> ast;
+    cpm::sc::SemanticChecker semanticChecker(context, std::cout);
+    cpm::LLBuilder llBuilder;
+
+    try {
+        ast = p.parse();
+        semanticChecker.run(*ast);
+        llBuilder.run(ast.get());
+        if (llBuilder.verifyModule()) {
+            std::cout << "error: module is invalid" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // the function bodies generated in parallel must link into a valid module, which
+        // is the same as the one generated on a single thread; the lifetime markers must be
+        // valid as well
+        cpm::CodegenOptions parallelOpts;
+        parallelOpts.threads = 4;
+        parallelOpts.lifetime_markers = true;
+        cpm::LLBuilder parallelBuilder(parallelOpts);
+        parallelBuilder.run(ast.get());
+        if (parallelBuilder.verifyModule()) {
+            std::cout << "error: module generated on 4 threads is invalid" << std::endl;
+            return EXIT_FAILURE;
+        }
+        cpm::CodegenOptions serialOpts = parallelOpts;
+        serialOpts.threads = 1;
+        cpm::LLBuilder serialBuilder(serialOpts);
+        serialBuilder.run(ast.get());
+        if (printModule(parallelBuilder) != printModule(serialBuilder)) {
+            std::cout << "error: modules generated on 1 and 4 threads differ" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        cpm::CodegenOptions ssaOpts;
+        ssaOpts.ssa_locals = true;
+        cpm::LLBuilder ssaBuilder(ssaOpts);
+        ssaBuilder.run(ast.get());
+        if (ssaBuilder.verifyModule()) {
+            std::cout << "error: module with locals in ssa registers is invalid" << std::endl;
+            return EXIT_FAILURE;
+        }
+        // all locals of the sample are scalars whose address isn't taken, none needs a stack slot
+        if (std::filesystem::exists(fileSsa))
+            if (const llvm::AllocaInst *alloca = anyAlloca(ssaBuilder.getModule())) {
+                std::cout << "error: local " << alloca->getName().str() << " of function "
+                          << alloca->getFunction()->getName().str()
+                          << " isn't kept in ssa registers" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+        // the attributes must survive the optimizer, the checks below see the optimized module
+        cpm::CodegenOptions optimizedOpts;
+        optimizedOpts.lifetime_markers = true;
+        optimizedOpts.whole_program = true;
+        cpm::LLBuilder optimizedBuilder(optimizedOpts);
+        optimizedBuilder.run(ast.get());
+        if (optimizedBuilder.verifyModule()) {
+            std::cout << "error: module built for -O2 is invalid" << std::endl;
+            return EXIT_FAILURE;
+        }
+        optimize(optimizedBuilder.getModule());
+
+        // the stack slots of all locals and temporaries are allocated in the entry block, once
+        // per call, not on every iteration of a loop; in the 4 thread build, the lifetime
+        // markers say where the slots are used instead
+        for (cpm::LLBuilder *builder: {&llBuilder, &parallelBuilder, &ssaBuilder})
+            if (const llvm::AllocaInst *alloca = allocaOutsideEntryBlock(builder->getModule())) {
+                std::cout << "error: alloca outside the entry block of function "
+                          << alloca->getFunction()->getName().str() << std::endl;
+                return EXIT_FAILURE;
+            }
+
+        // c+- has no exceptions; the whole program is optimized as one, nothing else calls into it
+        for (cpm::LLBuilder *builder: {&llBuilder, &parallelBuilder, &ssaBuilder, &optimizedBuilder})
+            if (const llvm::Function *func =
+                        wrongLinkageOrUnwind(builder->getModule(), builder == &optimizedBuilder)) {
+                std::cout << "error: function " << func->getName().str()
+                          << " isn't nounwind, or isn't internal in the whole program" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+        // each line is a function and an attribute from the effects analysis it must have,
+        // or must not have if the attribute starts with '!'
+        if (const auto effects = readFile(fileEffects)) {
+            std::istringstream lines(*effects);
+            for (std::string name, effect; lines >> name >> effect;) {
+                const bool expected = effect.front() != '!';
+                if (!expected)
+                    effect.erase(0, 1);
+                for (cpm::LLBuilder *builder: {&llBuilder, &parallelBuilder, &ssaBuilder,
+                                               &optimizedBuilder}) {
+                    const llvm::Function *func = builder->getModule().getFunction(name);
+                    if (!func || hasEffect(*func, effect) != expected) {
+                        std::cout << "error: function " << name << (expected ? " isn't " : " is ")
+                                  << effect << std::endl;
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+        }
+
+        // the if conditions and sizeofs of the sample are folded, there's no code for them
+        if (std::filesystem::exists(fileFolded))
+            if (const std::string unfolded = unfoldedCode(llBuilder.getModule()); !unfolded.empty()) {
+                std::cout << "error: constant isn't folded, found " << unfolded << std::endl;
+                return EXIT_FAILURE;
+            }
+
+        // globals with constant initializers are emitted as data, not stored at startup
+        if (const auto staticGlobals = readFile(fileStatic)) {
+            std::istringstream names(*staticGlobals);
+            for (std::string name; names >> name;)
+                for (cpm::LLBuilder *builder: {&llBuilder, &parallelBuilder, &ssaBuilder})
+                    if (!staticallyInitialized(builder->getModule(), name)) {
+                        std::cout << "error: global " << name << " isn't initialized statically"
+                                  << std::endl;
+                        return EXIT_FAILURE;
+                    }
+        }
+    } catch (const std::exception &e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,3 @@
+// array sizes are evaluated during parsing, before the names are known
+const int n = 3;
+int arr[n + 1];
@@ -0,0 +1,11 @@
+int main() {
+	// error, Point is used as a type before its declaration, the parser only knows
+	// the classes declared so far
+	Point p;
+	return 0;
+}
+
+struct Point {
+	int x;
+	int y;
+};
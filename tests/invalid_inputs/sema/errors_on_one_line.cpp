@@ -0,0 +1,9 @@
+// errors: 5
+// test that the errors of bodies on one line are reported in the same order with any thread count
+
+int f() { return unknown_f; } int g() { return unknown_g; } int h() { return unknown_h; }
+int i() { 5 = 1; return 0; } int j() { 6 = 1; return 0; }
+
+int main() {
+	return f() + g() + h() + i() + j();
+}
@@ -0,0 +1,93 @@
+// errors: 20
+// more errors than the limit of 20, in function bodies and global declarations;
+// checking the bodies in parallel must report the same first 20
+
+void v0;
+
+int f1() {
+	return x1;
+}
+
+int f2() {
+	return x2;
+}
+
+void v3;
+
+int f4() {
+	return x4;
+}
+
+int f5() {
+	return x5;
+}
+
+void v6;
+
+int f7() {
+	return x7;
+}
+
+int f8() {
+	return x8;
+}
+
+void v9;
+
+int f10() {
+	return x10;
+}
+
+int f11() {
+	return x11;
+}
+
+void v12;
+
+int f13() {
+	return x13;
+}
+
+int f14() {
+	return x14;
+}
+
+void v15;
+
+int f16() {
+	return x16;
+}
+
+int f17() {
+	return x17;
+}
+
+void v18;
+
+int f19() {
+	return x19;
+}
+
+int f20() {
+	return x20;
+}
+
+void v21;
+
+int f22() {
+	return x22;
+}
+
+int f23() {
+	return x23;
+}
+
+void v24;
+
+int f25() {
+	return x25;
+}
+
+int main() {
+	return 0;
+}
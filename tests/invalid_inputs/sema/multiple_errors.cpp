@@ -0,0 +1,26 @@
+// errors: 5
+// test that the analysis goes on after an error and reports all of them
+
+struct S {
+	int a;
+	undefined_type b;
+	int c;
+};
+
+int f(int x) {
+	int *p1, *p2;
+	p1 + p2;
+	return x;
+}
+
+int main() {
+	S s;
+	s.c = 1;
+	5 = 1 + 2;
+	while (1) {
+		f(s);
+		break;
+	}
+	unknown = 3;
+	return f(s.a);
+}
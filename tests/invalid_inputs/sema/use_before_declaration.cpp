@@ -0,0 +1,26 @@
+// errors: 3
+struct A {
+    int f() {
+        // the function is declared after the class
+        return g();
+    }
+};
+
+int h() {
+    B b;
+    return x;
+}
+
+struct B {
+    int y;
+};
+
+int g() {
+    return 1;
+}
+
+int x = 5;
+
+int main() {
+    return h() + g() + x;
+}
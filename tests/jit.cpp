@@ -0,0 +1,146 @@
+/**
+ * This program tests that a sample runs in-process with --run, that is, with the jit.
+ *
+ * The global constructors must run before main, the value returned from main is the exit code,
+ * and the program reads the compiler's stdin and writes to the compiler's stdout.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "jit/Jit.h"
+#include "ll_builder/LLBuilder.h"
+#include "parser/Parser.h"
+#include "semantic_checker/SemanticChecker.h"
+#include "tests/configure.cmake.h"
+
+using namespace std::string_literals;
+
+namespace {
+    std::optional<std::string> readFile(const std::filesystem::path &path) {
+        if (!std::filesystem::exists(path)) {
+            return {};
+        }
+
+        std::ifstream ifs(path);
+        std::ostringstream ss;
+        ss << ifs.rdbuf();
+        return ss.str();
+    }
+
+    /**
+     * Point the file descriptor at the file for the lifetime of the object, the jitted
+     * program uses the descriptors of this process.
+     */
+    class Redirect {
+    public:
+        Redirect(int fd, const std::filesystem::path &path, int flags) : fd(fd), saved(dup(fd)) {
+            int file = open(path.c_str(), flags, 0644);
+            if (saved < 0 || file < 0)
+                throw std::runtime_error("can't redirect to " + path.string());
+            dup2(file, fd);
+            close(file);
+        }
+
+        ~Redirect() {
+            dup2(saved, fd);
+            close(saved);
+        }
+
+        Redirect(const Redirect &) = delete;
+        Redirect &operator=(const Redirect &) = delete;
+
+    private:
+        int fd;
+        int saved;
+    };
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cout << "Missing filepath" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto inputFilepath = std::filesystem::path{argv[1]};
+    const auto fileExitCode =
+            inputFilepath.parent_path() / (std::string{inputFilepath.stem()} + ".ret"s);
+    const auto fileRunInput =
+            inputFilepath.parent_path() / (std::string{inputFilepath.stem()} + ".in"s);
+    const auto fileRunOutput =
+            inputFilepath.parent_path() / (std::string{inputFilepath.stem()} + ".output"s);
+    const auto fileDontRun =
+            inputFilepath.parent_path() / (std::string{inputFilepath.stem()} + ".dontrun"s);
+
+    if (std::filesystem::exists(fileDontRun)) {
+        std::cout << ".dontrun found" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    std::ifstream ifs(inputFilepath);
+    if (!ifs || !ifs.is_open()) {
+        std::cout << "File " << argv[1] << " could not be opened." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto testdir = std::filesystem::path{CMAKE_CURRENT_BINARY_DIR} / "tests" / "jit" /
+                         inputFilepath.filename();
+    const auto tmpOutput = testdir / "output.txt";
+    std::filesystem::remove_all(testdir);
+    std::filesystem::create_directories(testdir);
+
+    cpm::Context context(ifs);
+    Parser p(context);
+    ast::node_ptr<ast::TranslationUnit> ast;
+    cpm::sc::SemanticChecker semanticChecker(context, std::cout);
+    cpm::LLBuilder llBuilder;
+
+    int returned;
+    try {
+        ast = p.parse();
+        semanticChecker.run(*ast);
+        llBuilder.run(ast.get());
+        if (llBuilder.verifyModule()) {
+            std::cout << "error: module is invalid" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        auto [llvmContext, module] = llBuilder.releaseModule();
+        std::cout.flush();
+        std::fflush(stdout);
+        {
+            // without a .in file, the program reads an empty stdin
+            Redirect in(STDIN_FILENO, std::filesystem::exists(fileRunInput) ? fileRunInput
+                                                                             : "/dev/null",
+                        O_RDONLY);
+            Redirect out(STDOUT_FILENO, tmpOutput, O_WRONLY | O_CREAT | O_TRUNC);
+            returned = cpm::Jit().run(std::move(llvmContext), std::move(module));
+        }
+    } catch (const std::exception &e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the process exit code keeps only the low byte, as in the executable from the run test
+    const auto returnValue = readFile(fileExitCode).value_or("0");
+    if ((returned & 0xff) != std::stoi(returnValue)) {
+        std::cout << "Run expected exit code = " << returnValue << std::endl;
+        std::cout << "main returned " << returned << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auto expectedOutput = readFile(fileRunOutput);
+    if (expectedOutput && readFile(tmpOutput) != expectedOutput) {
+        std::cout << "Run output mismatch. Expected stdout = " << *expectedOutput << std::endl;
+        std::cout << "Output saved as file " << tmpOutput << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/**
+ * This program tests that the hand-written lexer produces the same tokens
+ * as the lexer generated by antlr, and reports the same errors.
+ */
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "parser/Parser.h"
+#include "parser/BufferCharStream.h"
+#include "parser/BufferLexer.h"
+#include "CPMLexer.h"
+
+namespace {
+    struct LexerError {
+        size_t line;
+        size_t column;
+        std::string msg;
+
+        bool operator==(const LexerError &) const = default;
+    };
+
+    /**
+     * Keeps the errors reported by a lexer.
+     */
+    class RecordingErrorListener : public antlr4::BaseErrorListener {
+    public:
+        void syntaxError(antlr4::Recognizer *, antlr4::Token *, size_t line,
+                         size_t charPositionInLine, const std::string &msg,
+                         std::exception_ptr) override {
+            errors.push_back({line, charPositionInLine, msg});
+        }
+
+        std::vector<LexerError> errors;
+    };
+
+    std::ostream &operator<<(std::ostream &os, const std::vector<LexerError> &errors) {
+        for (const LexerError &e: errors)
+            os << "  line " << e.line << ":" << e.column << " " << e.msg << std::endl;
+        return os;
+    }
+
+    // the errors are reported on the way, both lexers are at the end now
+    if (antlr_errors.errors != buffer_errors.errors) {
+        std::cout << "error: lexer errors differ" << std::endl;
+        std::cout << "expected:" << std::endl << antlr_errors.errors;
+        std::cout << "actual:" << std::endl << buffer_errors.errors;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cout << "Missing filepath" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream ifs(argv[1]);
+    if (!ifs || !ifs.is_open()) {
+        std::cout << "File " << argv[1] << " could not be opened." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    cpm::Context context(ifs);
+    BufferCharStream antlr_input(context.getInput());
+    BufferCharStream buffer_input(context.getInput());
+    RecordingErrorListener antlr_errors, buffer_errors;
+    CPMLexer antlr_lexer(&antlr_input);
+    antlr_lexer.removeErrorListeners();
+    antlr_lexer.addErrorListener(&antlr_errors);
+    BufferLexer buffer_lexer(buffer_input, &buffer_errors);
+
+    while (true) {
+        auto expected = antlr_lexer.nextToken();
+        auto actual = buffer_lexer.nextToken();
+        if (expected->getType() != actual->getType() ||
+            expected->getText() != actual->getText() ||
+            expected->getLine() != actual->getLine() ||
+            expected->getCharPositionInLine() != actual->getCharPositionInLine() ||
+            expected->getStartIndex() != actual->getStartIndex() ||
+            expected->getStopIndex() != actual->getStopIndex()) {
+            std::cout << "error: tokens differ" << std::endl;
+            std::cout << "expected: " << expected->toString() << std::endl;
+            std::cout << "actual:   " << actual->toString() << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (expected->getType() == antlr4::Token::EOF)
+            break;
+    }
+
+    // the errors are reported on the way, both lexers are at the end now
+    if (antlr_errors.errors != buffer_errors.errors) {
+        std::cout << "error: lexer errors differ" << std::endl;
+        std::cout << "expected:" << std::endl << antlr_errors.errors;
+        std::cout << "actual:" << std::endl << buffer_errors.errors;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+/**
+ * This program tests that a valid sample is parsed on the fast path, with SLL prediction,
+ * without falling back to full LL prediction.
+ */
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include "parser/Parser.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cout << "Missing filepath" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream ifs(argv[1]);
+    if (!ifs || !ifs.is_open()) {
+        std::cout << "File " << argv[1] << " could not be opened." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    cpm::Context context(ifs);
+    Parser p(context);
+
+    try {
+        p.parse();
+    } catch (const std::exception &e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (p.getParseStage() != Parser::ParseStage::SLL) {
+        std::cout << "error: SLL prediction failed, the file was parsed again with LL" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
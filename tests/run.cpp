@@ -7,7 +7,9 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include "emitter/Emitter.h"
 #include "ll_builder/LLBuilder.h"
+#include "optimizer/Optimizer.h"
 #include "parser/Parser.h"
 #include "semantic_checker/SemanticChecker.h"
 #include "tests/configure.cmake.h"
@@ -43,6 +45,19 @@ namespace {
         ss << ifs.rdbuf();
         return ss.str();
     }
+
+    /**
+     * Emit the module as an object file in-process, clang is only used as the linker.
+     * Above -O0, the module is optimized first, the same way the driver does it.
+     */
+    void emitObject(llvm::Module &module, std::ostream &os,
+                    cpm::OptLevel level = cpm::OptLevel::O0) {
+        cpm::Emitter emitter(cpm::EmitKind::Object, level);
+        emitter.prepareModule(module);
+        if (level != cpm::OptLevel::O0)
+            cpm::Optimizer(level, emitter.getTargetMachine()).run(module);
+        emitter.run(module, os);
+    }
 }
 
 ProcessResult runProcess(const std::string &executable, std::initializer_list<std::string> args,
@@ -82,28 +97,51 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    const auto inputFilepath = std::filesystem::path{argv[1]};
+
     cpm::Context context(ifs);
     Parser p(context);
     ast::node_ptr<ast::TranslationUnit> ast;
     cpm::sc::SemanticChecker semanticChecker(context, std::cout);
     cpm::LLBuilder llBuilder;
 
-    std::ostringstream llvmIRStream;
+    std::ostringstream objectStream, parallelObjectStream, ssaObjectStream, optimizedObjectStream;
     try {
         ast = p.parse();
         semanticChecker.run(*ast);
         llBuilder.run(ast.get());
-        llBuilder.dumpModule(llvmIRStream);
+        emitObject(llBuilder.getModule(), objectStream);
+
+        // the builds with the other codegen options must behave the same, their ir is
+        // checked by the codegen test
+        cpm::CodegenOptions parallelOpts;
+        parallelOpts.threads = 4;
+        parallelOpts.lifetime_markers = true;
+        cpm::LLBuilder parallelBuilder(parallelOpts);
+        parallelBuilder.run(ast.get());
+        emitObject(parallelBuilder.getModule(), parallelObjectStream);
+
+        cpm::CodegenOptions ssaOpts;
+        ssaOpts.ssa_locals = true;
+        cpm::LLBuilder ssaBuilder(ssaOpts);
+        ssaBuilder.run(ast.get());
+        emitObject(ssaBuilder.getModule(), ssaObjectStream);
+
+        // the optimizer trusts the function attributes and the lifetime markers, a wrong
+        // one shows up as a miscompiled program
+        cpm::CodegenOptions optimizedOpts;
+        optimizedOpts.lifetime_markers = true;
+        optimizedOpts.whole_program = true;
+        cpm::LLBuilder optimizedBuilder(optimizedOpts);
+        optimizedBuilder.run(ast.get());
+        emitObject(optimizedBuilder.getModule(), optimizedObjectStream, cpm::OptLevel::O2);
     } catch (const std::exception &e) {
         std::cout << "error: " << e.what() << std::endl;
         return EXIT_FAILURE;
     }
 
-    const auto inputFilepath = std::filesystem::path{argv[1]};
-
     const auto testdir = std::filesystem::path{CMAKE_CURRENT_BINARY_DIR} / "tests" / "run" /
                          inputFilepath.filename();
-    const auto executable = testdir / "a.out";
     const auto tmpOutput = testdir / "output.bin";
 
     const auto fileExitCode =
@@ -123,31 +161,41 @@ int main(int argc, char *argv[]) {
     std::filesystem::remove_all(testdir);
     std::filesystem::create_directories(testdir);
 
-    auto compilerInput = llvmIRStream.str();
-    auto compiler = runProcess(CLANG_EXECUTABLE,
-                               {"-x", "ir", "-", "-Wno-override-module", "-o", executable},
-                               compilerInput);
-    if (compiler.exit_code != 0) {
-        std::cout << "Compile: " << compiler << std::endl;
-        return EXIT_FAILURE;
-    }
+    const auto runInput = readFile(fileRunInput);
+    const auto returnValue = readFile(fileExitCode).value_or("0");
+    const auto expectedOutput = readFile(fileRunOutput);
+    const std::pair<std::string, const std::ostringstream *> builds[] = {
+            {"a", &objectStream},
+            {"parallel", &parallelObjectStream},
+            {"ssa", &ssaObjectStream},
+            {"O2", &optimizedObjectStream}};
+    for (const auto &[name, stream]: builds) {
+        const auto executable = testdir / (name + ".out");
+        const auto objectFile = testdir / (name + ".o");
+        {
+            std::ofstream ofs(objectFile, std::ios::binary);
+            ofs << stream->str();
+        }
+        auto compiler = runProcess(CLANG_EXECUTABLE, {objectFile, "-o", executable}, {});
+        if (compiler.exit_code != 0) {
+            std::cout << "Compile " << name << ": " << compiler << std::endl;
+            return EXIT_FAILURE;
+        }
 
-    auto runInput = readFile(fileRunInput);
-    auto run = runProcess(executable, {}, readFile(fileRunInput));
+        auto run = runProcess(executable, {}, runInput);
 
-    auto returnValue = readFile(fileExitCode).value_or("0");
-    if (run.exit_code != std::stoi(returnValue)) {
-        std::cout << "Run expected exit code = " << returnValue << std::endl;
-        std::cout << "Run: " << run << std::endl;
-        return EXIT_FAILURE;
-    }
+        if (run.exit_code != std::stoi(returnValue)) {
+            std::cout << "Run expected exit code = " << returnValue << std::endl;
+            std::cout << "Run " << name << ": " << run << std::endl;
+            return EXIT_FAILURE;
+        }
 
-    auto expectedOutput = readFile(fileRunOutput);
-    if (expectedOutput && run.out != expectedOutput) {
-        std::cout << "Run output mismatch. Expected stdout = " << *expectedOutput << std::endl;
-        std::cout << "Run: " << run << std::endl;
-        std::cout << "Output saved as file " << tmpOutput << std::endl;
-        return EXIT_FAILURE;
+        if (expectedOutput && run.out != expectedOutput) {
+            std::cout << "Run output mismatch. Expected stdout = " << *expectedOutput << std::endl;
+            std::cout << "Run " << name << ": " << run << std::endl;
+            std::cout << "Output saved as file " << tmpOutput << std::endl;
+            return EXIT_FAILURE;
+        }
     }
 
     return EXIT_SUCCESS;
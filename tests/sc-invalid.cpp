@@ -1,12 +1,28 @@
 /**
  * This program tests that a sample fails during semantic analysis.
+ *
+ * If the first line of the sample is '// errors: N', the analysis must report
+ * exactly N errors.
+ *
+ * The analysis with function bodies checked in parallel must report the same errors.
  */
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <optional>
+#include <vector>
+#include <string>
+#include <string_view>
 #include "semantic_checker/SemanticChecker.h"
 #include "parser/Parser.h"
 
+std::optional<size_t> expect_errors(std::string_view first_line) {
+    constexpr std::string_view prefix = "// errors: ";
+    if (!first_line.starts_with(prefix))
+        return std::nullopt;
+    return std::stoul(std::string(first_line.substr(prefix.size())));
+}
+
 int main(int argc, char *argv[]) {
     if (argc != 2) {
         std::cout << "Missing filepath" << std::endl;
@@ -20,24 +36,50 @@ int main(int argc, char *argv[]) {
     }
 
     cpm::Context context(ifs);
-    Parser p(context);
-    ast::node_ptr<ast::TranslationUnit> ast;
 
-    try {
-        ast = p.parse();
-    } catch (const std::exception &e) {
-        std::cout << "error: file didn't pass parsing though it should" << e.what() << std::endl;
+    // the analysis modifies the ast, so each run gets a fresh one
+    auto check = [&](unsigned threads) -> std::optional<std::vector<std::string>> {
+        Parser p(context);
+        ast::node_ptr<ast::TranslationUnit> ast;
+        try {
+            ast = p.parse();
+        } catch (const std::exception &e) {
+            std::cout << "error: file didn't pass parsing though it should" << e.what() << std::endl;
+            return std::nullopt;
+        }
+
+        cpm::sc::SemanticChecker semanticChecker(context, std::cout, 20, threads);
+        try {
+            semanticChecker.run(*ast);
+            std::cout << "error: file passed semantic analysis though it should fail"
+                      << (threads > 1 ? " with parallel bodies" : "") << std::endl;
+            return std::nullopt;
+        }
+        catch (const std::exception &e) {
+            return semanticChecker.getErrors();
+        }
+    };
+
+    std::optional<std::vector<std::string>> errors = check(1);
+    if (!errors)
+        return EXIT_FAILURE;
+    std::optional<size_t> expected_errors = expect_errors(context.getLine(1));
+    if (expected_errors && errors->size() != *expected_errors) {
+        std::cout << "error: expected " << *expected_errors << " errors, got "
+                  << errors->size() << ":" << std::endl;
+        for (const std::string &e: *errors)
+            std::cout << e << std::endl;
         return EXIT_FAILURE;
     }
 
-    cpm::sc::SemanticChecker semanticChecker(context, std::cout);
-    try {
-        semanticChecker.run(*ast);
-        std::cout << "error: file passed semantic analysis though it should fail" << std::endl;
+    std::optional<std::vector<std::string>> parallel_errors = check(4);
+    if (!parallel_errors)
+        return EXIT_FAILURE;
+    if (*parallel_errors != *errors) {
+        std::cout << "error: parallel analysis reported different errors:" << std::endl;
+        for (const std::string &e: *parallel_errors)
+            std::cout << e << std::endl;
         return EXIT_FAILURE;
     }
-    catch (const std::exception &e) {
-        return EXIT_SUCCESS;
-    }
+    return EXIT_SUCCESS;
 }
-
@@ -0,0 +1,191 @@
+/**
+ * This program tests that the compile server (--daemon) compiles a sample the same way as
+ * the client would compile it by itself.
+ *
+ * The server runs on a thread of this process, the sample is sent with several options and
+ * the responses must match the local compilation: exit code, output and messages. Then the
+ * server is occupied by idle clients, one per core; they must be disconnected after the io
+ * timeout, so the sample is still compiled. Requests the server doesn't handle, of another
+ * protocol version or too large, must make the client compile by itself.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server/CompileServer.h"
+
+namespace {
+    cpm::server::Response compileLocally(const cpm::server::Request &req) {
+        std::istringstream source(req.source);
+        std::ostringstream out, log, err;
+        cpm::server::Response res;
+        res.exit_code = cpm::driver::compile(source, std::nullopt, req.opts, {out, log, err});
+        res.out = out.str();
+        res.log = log.str();
+        res.err = err.str();
+        return res;
+    }
+
+    bool operator==(const cpm::server::Response &a, const cpm::server::Response &b) {
+        return a.exit_code == b.exit_code && a.out == b.out && a.log == b.log && a.err == b.err;
+    }
+
+    /**
+     * Connect to the server without sending anything.
+     * @return the socket, -1 on failure
+     */
+    int connectIdle(const std::string &socketPath) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cout << "Missing filepath" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream ifs(argv[1]);
+    if (!ifs || !ifs.is_open()) {
+        std::cout << "File " << argv[1] << " could not be opened." << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::ostringstream source;
+    source << ifs.rdbuf();
+
+    // the path of a unix socket is limited to ~100 characters, the build directory may be deeper
+    const auto socketPath = std::filesystem::temp_directory_path() /
+                            ("cpm-test-server-" + std::to_string(getpid()) + ".sock");
+
+    std::vector<cpm::driver::CompileOptions> variants(4);
+    variants[1].ast_dump = true;
+    variants[2].opt_level = cpm::OptLevel::O2;
+    variants[2].emit_kind = cpm::EmitKind::Object;
+    variants[2].whole_program = true;
+    variants[2].ssa_locals = true;
+    // the server uses at most one thread per core
+    variants[3].sema_threads = 1000;
+    variants[3].codegen_threads = 1000;
+
+    // short, so that the idle clients are disconnected soon
+    const auto ioTimeout = std::chrono::milliseconds(500);
+
+    int result = EXIT_SUCCESS;
+    try {
+        cpm::server::CompileServer server(socketPath.string(), ioTimeout);
+        std::thread serving([&server]() { server.serve(); });
+
+        for (size_t i = 0; i < variants.size() && result == EXIT_SUCCESS; i++) {
+            auto remote = cpm::server::request_compile(socketPath.string(),
+                                                       {variants[i], source.str()});
+            if (!remote) {
+                std::cout << "error: compile server couldn't be reached" << std::endl;
+                result = EXIT_FAILURE;
+                break;
+            }
+
+            cpm::driver::CompileOptions localOpts = variants[i];
+            const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+            localOpts.sema_threads = std::min(localOpts.sema_threads, cores);
+            localOpts.codegen_threads = std::min(localOpts.codegen_threads, cores);
+            const cpm::server::Response local = compileLocally({localOpts, source.str()});
+            if (!(*remote == local)) {
+                std::cout << "error: compile server returned a different result for options #"
+                          << i << std::endl;
+                std::cout << "exit code " << remote->exit_code << " vs " << local.exit_code
+                          << ", output of " << remote->out.size() << " vs " << local.out.size()
+                          << " bytes" << std::endl;
+                std::cout << "server messages:" << std::endl << remote->log << remote->err;
+                std::cout << "local messages:" << std::endl << local.log << local.err;
+                result = EXIT_FAILURE;
+            }
+        }
+
+        // every connection the server handles at a time is taken by a client that sends nothing
+        std::vector<int> idleClients;
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < cores && result == EXIT_SUCCESS; i++) {
+            int fd = connectIdle(socketPath.string());
+            if (fd < 0) {
+                std::cout << "error: idle client couldn't connect" << std::endl;
+                result = EXIT_FAILURE;
+                break;
+            }
+            idleClients.push_back(fd);
+        }
+        if (result == EXIT_SUCCESS) {
+            auto start = std::chrono::steady_clock::now();
+            auto remote = cpm::server::request_compile(socketPath.string(),
+                                                       {variants[0], source.str()});
+            auto waited = std::chrono::steady_clock::now() - start;
+            if (!remote || !(*remote == compileLocally({variants[0], source.str()}))) {
+                std::cout << "error: compile server didn't answer while idle clients were "
+                             "connected" << std::endl;
+                result = EXIT_FAILURE;
+            } else if (waited < ioTimeout / 2) {
+                std::cout << "error: the idle clients didn't occupy the server" << std::endl;
+                result = EXIT_FAILURE;
+            }
+        }
+        // the server has closed the idle connections, they read the end of the stream
+        for (int fd: idleClients) {
+            char byte;
+            if (result == EXIT_SUCCESS && recv(fd, &byte, 1, 0) != 0) {
+                std::cout << "error: idle client wasn't disconnected" << std::endl;
+                result = EXIT_FAILURE;
+            }
+            close(fd);
+        }
+
+        // a request of another version is answered by the "not handled" status (-1),
+        // not by a failed compilation
+        if (result == EXIT_SUCCESS) {
+            int fd = connectIdle(socketPath.string());
+            const uint32_t header[] = {0x534d5043 /* "CPMS" */, 1000};
+            const uint64_t bodySize = 0;
+            int32_t status = 0;
+            if (fd < 0 || send(fd, header, sizeof(header), MSG_NOSIGNAL) != sizeof(header) ||
+                send(fd, &bodySize, sizeof(bodySize), MSG_NOSIGNAL) != sizeof(bodySize) ||
+                recv(fd, &status, sizeof(status), MSG_WAITALL) != sizeof(status) || status != -1) {
+                std::cout << "error: request of another protocol version wasn't refused" << std::endl;
+                result = EXIT_FAILURE;
+            }
+            if (fd >= 0)
+                close(fd);
+        }
+        // the client doesn't send a source the server would refuse
+        if (result == EXIT_SUCCESS &&
+            cpm::server::request_compile(socketPath.string(),
+                                         {variants[0], std::string(cpm::server::max_source_size + 1,
+                                                                   ' ')})) {
+            std::cout << "error: source over the size limit was compiled by the server" << std::endl;
+            result = EXIT_FAILURE;
+        }
+
+        server.stop();
+        serving.join();
+    } catch (const std::exception &e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return result;
+}
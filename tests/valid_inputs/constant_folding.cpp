@@ -0,0 +1,10 @@
+// constants are folded during semantic analysis, array sizes can be constant expressions
+int arr[2 * 5 + 1];
+const int N = 3 * 4;
+
+int main() {
+	double d = N / 5 + 0.5;
+	if (N > 10)
+		return sizeof(arr) / sizeof(int) + (int) (d * 2.0);
+	return 0;
+}
@@ -0,0 +1,33 @@
+// functions get llvm attributes by what they do to the memory, the calls to get()
+// must not be merged over the store through the pointer
+int g;
+
+int odd(int n);
+
+int even(int n) {
+	if (n == 0)
+		return 1;
+	return odd(n - 1);
+}
+
+int odd(int n) {
+	if (n == 0)
+		return 0;
+	return even(n - 1);
+}
+
+int get() {
+	return g;
+}
+
+void set(int *p, int x) {
+	*p = x;
+}
+
+int main() {
+	int x = 0;
+	set(&x, 5);
+	g = get() + x;
+	set(&g, get() + 1);
+	return odd(7) + even(4) + get() + x;
+}
@@ -0,0 +1,37 @@
+// globals with constant initializers are emitted as static data, the rest are
+// initialized by run_global_ctors at startup (see global_initializers.static)
+struct Point {
+	int x;
+	int y;
+};
+
+int arr[5];
+Point origin;
+
+const int base = 6 * 7;
+int scaled = base / 2 + 1;
+double half = (double) 7 / 2;
+char letter = (char) 65;
+int size = sizeof(Point);
+int ints = sizeof(int) * 4;
+const char *greeting = "hi";
+int *third = &arr[2];
+int *origin_y = &origin.y;
+
+int seven() {
+	return 7;
+}
+
+// a call and a division by zero aren't constant, they are left to run time
+int called = seven();
+int undefined = 1 / 0;
+
+int main() {
+	*third = 3;
+	*origin_y = 4;
+	if (greeting[1] != 'i')
+		return 1;
+	if (letter != 'A')
+		return 2;
+	return scaled + (int) half + size + ints + arr[2] + origin.y + called;
+}
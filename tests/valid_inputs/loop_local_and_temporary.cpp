@@ -0,0 +1,21 @@
+struct Point {
+	int x;
+	int y;
+	Point(int x, int y) {
+		this->x = x;
+		this->y = y;
+	}
+};
+
+int sum(Point p) {
+	return p.x + p.y;
+}
+
+int main() {
+	int total = 0;
+	for (int i = 0; i < 10; i++) {
+		Point p(i, 1);
+		total = total + p.x + sum(Point(1, 2));
+	}
+	return total;
+}